@@ -42,6 +42,10 @@ namespace NCL {
 			//return collision.collidedAt;
 		}
 
+		int GetFeature(const Vector3& dir, const Transform& transform, Vector3* points) {
+			return GetBoxFeature(halfSizes, dir, transform, points);
+		}
+
 	protected:
 		Vector3 halfSizes;
 	};
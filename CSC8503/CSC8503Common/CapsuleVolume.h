@@ -57,6 +57,32 @@ namespace NCL {
 
 		}
 
+		//Lying flat against dir the capsule touches along a whole line, otherwise at one point
+		int GetFeature(const Vector3& dir, const Transform& transform, Vector3* points) {
+			Vector3 localDir = transform.GetInvRotMatrix() * dir;
+			localDir.Normalise();
+			if (fabs(localDir.y) > 0.05f) {
+				points[0] = Support(dir, transform);
+				return 1;
+			}
+			Vector3 offset = Vector3(localDir.x, 0, localDir.z).Normalised() * radius;
+			Matrix3 rot = transform.GetRotMatrix();
+			points[0] = rot * (offset + Vector3(0, halfHeight - radius, 0)) + transform.GetPosition();
+			points[1] = rot * (offset - Vector3(0, halfHeight - radius, 0)) + transform.GetPosition();
+			return 2;
+		}
+
+		float GetMargin() const {
+			return radius;
+		}
+
+		//Core is the line between the centres of the end spheres
+		Vector3 CoreSupport(const Vector3& dir, const Transform& transform) {
+			Vector3 localDir = transform.GetInvRotMatrix() * dir;
+			Vector3 result(0, (localDir.y > 0) ? halfHeight - radius : -(halfHeight - radius), 0);
+			return transform.GetRotMatrix() * result + transform.GetPosition();
+		}
+
     protected:
         float radius;
         float halfHeight;
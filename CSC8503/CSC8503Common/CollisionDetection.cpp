@@ -3,6 +3,7 @@
 #include "AABBVolume.h"
 #include "OBBVolume.h"
 #include "SphereVolume.h"
+#include "GJK.h"
 #include "../../Common/Vector2.h"
 #include "../../Common/Window.h"
 #include "../../Common/Maths.h"
@@ -31,8 +32,6 @@ bool CollisionDetection::RayPlaneIntersection(const Ray&r, const Plane&p, RayCol
 }
 
 bool CollisionDetection::RayIntersection(const Ray& r,GameObject& object, RayCollision& collision) {
-	bool hasCollided = false;
-
 	const Transform& worldTransform = object.GetTransform();
 	const CollisionVolume* volume	= object.GetBoundingVolume();
 
@@ -40,17 +39,76 @@ bool CollisionDetection::RayIntersection(const Ray& r,GameObject& object, RayCol
 		return false;
 	}
 
-	switch (volume->type) {
-		case VolumeType::AABB:		hasCollided = RayAABBIntersection(r, worldTransform, (const AABBVolume&)*volume	, collision); break;
-		case VolumeType::OBB:		hasCollided = RayOBBIntersection(r, worldTransform, (const OBBVolume&)*volume	, collision); break;
-		case VolumeType::Sphere:	hasCollided = RaySphereIntersection(r, worldTransform, (const SphereVolume&)*volume	, collision); break;
-		case VolumeType::Capsule:	hasCollided = RayCapsuleIntersection(r, worldTransform, (const CapsuleVolume&)*volume, collision); break;
-		case VolumeType::Cylinder:  hasCollided = RayCylinderIntersection(r, worldTransform, (const CylinderVolume&)*volume, collision); break;
+	return RayVolumeIntersection(r, worldTransform, *volume, collision);
+}
+
+bool CollisionDetection::RayVolumeIntersection(const Ray& r, const Transform& worldTransform, const CollisionVolume& volume, RayCollision& collision) {
+	bool hasCollided = false;
+
+	switch (volume.type) {
+		case VolumeType::AABB:		hasCollided = RayAABBIntersection(r, worldTransform, (const AABBVolume&)volume	, collision); break;
+		case VolumeType::OBB:		hasCollided = RayOBBIntersection(r, worldTransform, (const OBBVolume&)volume	, collision); break;
+		case VolumeType::Sphere:	hasCollided = RaySphereIntersection(r, worldTransform, (const SphereVolume&)volume	, collision); break;
+		case VolumeType::Capsule:	hasCollided = RayCapsuleIntersection(r, worldTransform, (const CapsuleVolume&)volume, collision); break;
+		case VolumeType::Cylinder:  hasCollided = RayCylinderIntersection(r, worldTransform, (const CylinderVolume&)volume, collision); break;
+		case VolumeType::Compound:	hasCollided = RayCompoundIntersection(r, worldTransform, (const CompoundVolume&)volume, collision); break;
+		case VolumeType::TriangleMesh: hasCollided = RayTriangleMeshIntersection(r, worldTransform, (const TriangleMeshVolume&)volume, collision); break;
+		case VolumeType::Heightfield: hasCollided = RayHeightfieldIntersection(r, worldTransform, (const HeightfieldVolume&)volume, collision); break;
 	}
 
 	return hasCollided;
 }
 
+//Only the children whose bounds the ray crosses are tested, and the nearest hit wins
+bool CollisionDetection::RayCompoundIntersection(const Ray& r, const Transform& worldTransform, const CompoundVolume& volume, RayCollision& collision) {
+	Matrix3 invRot	= worldTransform.GetInvRotMatrix();
+	Vector3 localPos = invRot * (r.GetPosition() - worldTransform.GetPosition());
+	Vector3 localDir = invRot * r.GetDirection();
+
+	std::vector<int> children;
+	volume.GetChildrenOnRay(localPos, localDir, collision.rayDistance, children);
+
+	bool hasCollided = false;
+	for (int i : children) {
+		RayCollision childCollision;
+		if (RayVolumeIntersection(r, volume.GetChildTransform(i, worldTransform), *volume.GetChildVolume(i), childCollision) &&
+			childCollision.rayDistance < collision.rayDistance) {
+			collision	= childCollision;
+			hasCollided = true;
+		}
+	}
+	return hasCollided;
+}
+
+bool CollisionDetection::RayTriangleMeshIntersection(const Ray& r, const Transform& worldTransform, const TriangleMeshVolume& volume, RayCollision& collision) {
+	Matrix3 invRot	 = worldTransform.GetInvRotMatrix();
+	Vector3 localPos = invRot * (r.GetPosition() - worldTransform.GetPosition());
+	Vector3 localDir = invRot * r.GetDirection();
+
+	float	distance;
+	int		triangle;
+	if (!volume.RayCast(localPos, localDir, collision.rayDistance, distance, triangle)) {
+		return false;
+	}
+	collision.rayDistance	= distance;
+	collision.collidedAt	= r.GetPosition() + r.GetDirection() * distance;
+	return true;
+}
+
+bool CollisionDetection::RayHeightfieldIntersection(const Ray& r, const Transform& worldTransform, const HeightfieldVolume& volume, RayCollision& collision) {
+	Matrix3 invRot	 = worldTransform.GetInvRotMatrix();
+	Vector3 localPos = invRot * (r.GetPosition() - worldTransform.GetPosition());
+	Vector3 localDir = invRot * r.GetDirection();
+
+	float distance;
+	if (!volume.RayCast(localPos, localDir, collision.rayDistance, distance)) {
+		return false;
+	}
+	collision.rayDistance	= distance;
+	collision.collidedAt	= r.GetPosition() + r.GetDirection() * distance;
+	return true;
+}
+
 bool CollisionDetection::RayBoxIntersection(const Ray&r, const Vector3& boxPos, const Vector3& boxSize, RayCollision& collision) {
 	Vector3 boxMin = boxPos - boxSize;
 	Vector3 boxMax = boxPos + boxSize;
@@ -583,6 +641,304 @@ bool CollisionDetection::ObjectIntersection(GameObject* a, GameObject* b, Collis
 	return false;
 }
 
+/*
+Pairs with a closed form test skip GJK entirely. The table is indexed by the bit
+position of each VolumeType, and filled in both orders so that the caller never
+has to swap objects around; a flipped test just flips its contact on the way out.
+*/
+CollisionDetection::PairTest CollisionDetection::pairTable[NUM_VOLUME_TYPES][NUM_VOLUME_TYPES];
+bool CollisionDetection::pairTableBuilt = false;
+
+int CollisionDetection::VolumeTypeIndex(VolumeType type) {
+	int index = 0;
+	for (int bits = (int)type; bits > 1; bits >>= 1) {
+		index++;
+	}
+	return index < NUM_VOLUME_TYPES ? index : -1;
+}
+
+void CollisionDetection::BuildPairTable() {
+	pairTableBuilt = true;
+	SetPairTest(VolumeType::Sphere,		VolumeType::Sphere,		SphereSpherePair);
+	SetPairTest(VolumeType::Sphere,		VolumeType::Capsule,	SphereCapsulePair);
+	SetPairTest(VolumeType::Capsule,	VolumeType::Sphere,		CapsuleSpherePair);
+	SetPairTest(VolumeType::Capsule,	VolumeType::Capsule,	CapsuleCapsulePair);
+
+	//Compounds against anything are split up into their children
+	int compound = VolumeTypeIndex(VolumeType::Compound);
+	for (int i = 0; i < NUM_VOLUME_TYPES; ++i) {
+		pairTable[compound][i] = CompoundIntersection;
+		pairTable[i][compound] = CompoundIntersection;
+	}
+	//and triangle meshes into triangles, which takes precedence as a mesh splits compounds up itself
+	int triangleMesh = VolumeTypeIndex(VolumeType::TriangleMesh);
+	for (int i = 0; i < NUM_VOLUME_TYPES; ++i) {
+		pairTable[triangleMesh][i] = TriangleMeshIntersection;
+		pairTable[i][triangleMesh] = TriangleMeshIntersection;
+	}
+	//heightfields are the same, and come last so a heightfield against a triangle mesh goes to one of them
+	int heightfield = VolumeTypeIndex(VolumeType::Heightfield);
+	for (int i = 0; i < NUM_VOLUME_TYPES; ++i) {
+		pairTable[heightfield][i] = HeightfieldIntersection;
+		pairTable[i][heightfield] = HeightfieldIntersection;
+	}
+}
+
+CollisionDetection::PairTest CollisionDetection::GetPairTest(VolumeType a, VolumeType b) {
+	if (!pairTableBuilt) {
+		BuildPairTable();
+	}
+	int ia = VolumeTypeIndex(a);
+	int ib = VolumeTypeIndex(b);
+	if (ia < 0 || ib < 0) {
+		return nullptr;
+	}
+	return pairTable[ia][ib];
+}
+
+void CollisionDetection::SetPairTest(VolumeType a, VolumeType b, PairTest test) {
+	if (!pairTableBuilt) {
+		BuildPairTable();
+	}
+	int ia = VolumeTypeIndex(a);
+	int ib = VolumeTypeIndex(b);
+	if (ia >= 0 && ib >= 0) {
+		pairTable[ia][ib] = test;
+	}
+}
+
+bool CollisionDetection::SphereSpherePair(GameObject* a, GameObject* b, CollisionInfo& collisionInfo) {
+	return SphereIntersection((SphereVolume&)*a->GetBoundingVolume(), a->GetTransform(),
+		(SphereVolume&)*b->GetBoundingVolume(), b->GetTransform(), collisionInfo);
+}
+
+bool CollisionDetection::CapsuleSpherePair(GameObject* a, GameObject* b, CollisionInfo& collisionInfo) {
+	return SphereCapsuleIntersection((CapsuleVolume&)*a->GetBoundingVolume(), a->GetTransform(),
+		(SphereVolume&)*b->GetBoundingVolume(), b->GetTransform(), collisionInfo);
+}
+
+bool CollisionDetection::SphereCapsulePair(GameObject* a, GameObject* b, CollisionInfo& collisionInfo) {
+	CollisionInfo flipped;
+	if (!CapsuleSpherePair(b, a, flipped)) {
+		return false;
+	}
+	const ContactPoint& p = flipped.point;
+	collisionInfo.AddContactPoint(p.localB, p.localA, -p.normal, p.penetration);
+	return true;
+}
+
+bool CollisionDetection::CapsuleCapsulePair(GameObject* a, GameObject* b, CollisionInfo& collisionInfo) {
+	return CapsuleIntersection((CapsuleVolume&)*a->GetBoundingVolume(), a->GetTransform(),
+		(CapsuleVolume&)*b->GetBoundingVolume(), b->GetTransform(), collisionInfo);
+}
+
+//World space box around a convex volume. Support along each axis boxes any volume, whether or not it has a broadphase box.
+static void VolumeBounds(CollisionVolume* volume, const Transform& transform, Vector3& boundsMin, Vector3& boundsMax) {
+	for (int axis = 0; axis < 3; ++axis) {
+		Vector3 dir;
+		dir.array[axis] = 1.0f;
+		boundsMax.array[axis] = volume->Support(dir, transform).array[axis];
+		boundsMin.array[axis] = volume->Support(-dir, transform).array[axis];
+	}
+}
+
+//Box around part of an object, moved into the space of another
+static void BoxInSpace(const Vector3& centre, const Vector3& halfSizes, const Transform& space, Vector3& boxMin, Vector3& boxMax) {
+	Matrix3 invRot = space.GetInvRotMatrix();
+	Vector3 localCentre		= invRot * (centre - space.GetPosition());
+	Vector3 localHalfSizes	= invRot.Absolute() * halfSizes;
+	boxMin = localCentre - localHalfSizes;
+	boxMax = localCentre + localHalfSizes;
+}
+
+/*
+A compound is tested child by child, each child with GJK/EPA, and the contacts from all
+of them are reduced down to one manifold. The other object is first boxed in the
+compound's space, and only children whose bounds overlap that box are looked at. If the
+other object is a compound too, its own children are culled against this one's bounds
+first, so only child pairs with overlapping bounds ever get to GJK.
+*/
+bool CollisionDetection::CompoundIntersection(GameObject* a, GameObject* b, CollisionInfo& collisionInfo) {
+	if (a->GetBoundingVolume()->type != VolumeType::Compound) {
+		CollisionInfo flipped;
+		if (!CompoundIntersection(b, a, flipped)) {
+			return false;
+		}
+		for (int i = 0; i < flipped.numContacts; ++i) {
+			const ContactPoint& p = flipped.contacts[i];
+			collisionInfo.AddContactPoint(p.localB, p.localA, -p.normal, p.penetration);
+		}
+		return true;
+	}
+	const CompoundVolume&	compound	= (const CompoundVolume&)*a->GetBoundingVolume();
+	const Transform&		transformA	= a->GetTransform();
+	const Transform&		transformB	= b->GetTransform();
+	CollisionVolume*		volumeB		= b->GetBoundingVolume();
+
+	//The parts of b to test, either b itself or the children of b near a
+	std::vector<int>			partsB;
+	std::vector<int>			childrenA;
+	std::vector<ContactPoint>	contacts;
+
+	const CompoundVolume* compoundB = (volumeB->type == VolumeType::Compound) ? (const CompoundVolume*)volumeB : nullptr;
+	if (compoundB) {
+		Vector3 boxMin, boxMax;
+		BoxInSpace(transformA.GetRotMatrix() * compound.GetLocalCentre() + transformA.GetPosition(),
+			transformA.GetRotMatrix().Absolute() * compound.GetLocalHalfSizes(), transformB, boxMin, boxMax);
+		compoundB->GetOverlappingChildren(boxMin, boxMax, partsB);
+	}
+	else {
+		partsB.push_back(-1);
+	}
+
+	for (int part : partsB) {
+		Transform			partTransform	= compoundB ? compoundB->GetChildTransform(part, transformB) : transformB;
+		CollisionVolume*	partVolume		= compoundB ? compoundB->GetChildVolume(part) : volumeB;
+
+		Vector3 centre, halfSizes;
+		if (compoundB) {
+			Vector3 childMin, childMax;
+			compoundB->GetChildBounds(part, childMin, childMax);
+			centre		= transformB.GetRotMatrix() * ((childMin + childMax) * 0.5f) + transformB.GetPosition();
+			halfSizes	= transformB.GetRotMatrix().Absolute() * ((childMax - childMin) * 0.5f);
+		}
+		else {
+			Vector3 boundsMin, boundsMax;
+			VolumeBounds(volumeB, transformB, boundsMin, boundsMax);
+			centre		= (boundsMin + boundsMax) * 0.5f;
+			halfSizes	= (boundsMax - boundsMin) * 0.5f;
+		}
+		Vector3 boxMin, boxMax;
+		BoxInSpace(centre, halfSizes, transformA, boxMin, boxMax);
+		compound.GetOverlappingChildren(boxMin, boxMax, childrenA);
+
+		for (int child : childrenA) {
+			Transform childTransform = compound.GetChildTransform(child, transformA);
+			ContactPoint p;
+			if (!GJKContact(compound.GetChildVolume(child), childTransform, partVolume, partTransform, p)) {
+				continue;
+			}
+			//GJK's offsets are from the parts, the contact wants them from the objects
+			p.localA = p.localA + childTransform.GetPosition() - transformA.GetPosition();
+			p.localB = p.localB + partTransform.GetPosition() - transformB.GetPosition();
+			contacts.push_back(p);
+		}
+	}
+	if (contacts.empty()) {
+		return false;
+	}
+
+	int numContacts = (int)contacts.size();
+	ReduceContactPoints(contacts.data(), numContacts);
+	for (int i = 0; i < numContacts; ++i) {
+		const ContactPoint& p = contacts[i];
+		collisionInfo.AddContactPoint(p.localA, p.localB, p.normal, p.penetration);
+	}
+	return true;
+}
+
+/*
+Contacts between a convex volume and the triangles of a mesh under it, with the mesh as A.
+The volume is boxed in the mesh's space, the mesh gives the triangles whose bounds overlap
+that box (from its BVH, or the cells under it for a heightfield), and each of those goes
+through GJK/EPA as a convex shape of its own.
+*/
+template<class MeshType>
+static void TriangleContacts(const MeshType& mesh, const Transform& meshTransform,
+	CollisionVolume* volume, const Transform& transform, std::vector<CollisionDetection::ContactPoint>& contacts) {
+	Vector3 boundsMin, boundsMax;
+	VolumeBounds(volume, transform, boundsMin, boundsMax);
+
+	Vector3 boxMin, boxMax;
+	BoxInSpace((boundsMin + boundsMax) * 0.5f, (boundsMax - boundsMin) * 0.5f, meshTransform, boxMin, boxMax);
+
+	std::vector<int> overlapping;
+	mesh.GetOverlappingTriangles(boxMin, boxMax, overlapping);
+
+	TriangleVolume	triangle;
+	Vector3			corners[3];
+	for (int i : overlapping) {
+		mesh.GetTriangle(i, corners);
+		triangle.SetVertices(corners[0], corners[1], corners[2]);
+
+		CollisionDetection::ContactPoint p;
+		if (GJKContact(&triangle, meshTransform, volume, transform, p)) {
+			contacts.push_back(p);
+		}
+	}
+}
+
+static bool IsMeshType(VolumeType type) {
+	return type == VolumeType::TriangleMesh || type == VolumeType::Heightfield;
+}
+
+//a is the mesh, b can be anything but another mesh or heightfield. Compounds are tested child by child.
+template<class MeshType>
+static bool MeshIntersection(GameObject* a, GameObject* b, CollisionDetection::CollisionInfo& collisionInfo) {
+	CollisionVolume* volumeB = b->GetBoundingVolume();
+	if (IsMeshType(volumeB->type)) {
+		return false;
+	}
+	const MeshType&		mesh		= (const MeshType&)*a->GetBoundingVolume();
+	const Transform&	transformA	= a->GetTransform();
+	const Transform&	transformB	= b->GetTransform();
+
+	std::vector<CollisionDetection::ContactPoint> contacts;
+	if (volumeB->type == VolumeType::Compound) {
+		const CompoundVolume& compound = (const CompoundVolume&)*volumeB;
+		for (int i = 0; i < compound.GetNumChildren(); ++i) {
+			Transform childTransform = compound.GetChildTransform(i, transformB);
+			size_t firstContact = contacts.size();
+			TriangleContacts(mesh, transformA, compound.GetChildVolume(i), childTransform, contacts);
+
+			for (size_t j = firstContact; j < contacts.size(); ++j) {
+				contacts[j].localB = contacts[j].localB + childTransform.GetPosition() - transformB.GetPosition();
+			}
+		}
+	}
+	else {
+		TriangleContacts(mesh, transformA, volumeB, transformB, contacts);
+	}
+	if (contacts.empty()) {
+		return false;
+	}
+
+	int numContacts = (int)contacts.size();
+	CollisionDetection::ReduceContactPoints(contacts.data(), numContacts);
+	for (int i = 0; i < numContacts; ++i) {
+		const CollisionDetection::ContactPoint& p = contacts[i];
+		collisionInfo.AddContactPoint(p.localA, p.localB, p.normal, p.penetration);
+	}
+	return true;
+}
+
+//Runs a test the other way round, and swaps the contacts back
+static bool FlippedIntersection(CollisionDetection::PairTest test, GameObject* a, GameObject* b, CollisionDetection::CollisionInfo& collisionInfo) {
+	CollisionDetection::CollisionInfo flipped;
+	if (!test(b, a, flipped)) {
+		return false;
+	}
+	for (int i = 0; i < flipped.numContacts; ++i) {
+		const CollisionDetection::ContactPoint& p = flipped.contacts[i];
+		collisionInfo.AddContactPoint(p.localB, p.localA, -p.normal, p.penetration);
+	}
+	return true;
+}
+
+bool CollisionDetection::TriangleMeshIntersection(GameObject* a, GameObject* b, CollisionInfo& collisionInfo) {
+	if (a->GetBoundingVolume()->type != VolumeType::TriangleMesh) {
+		return FlippedIntersection(TriangleMeshIntersection, a, b, collisionInfo);
+	}
+	return MeshIntersection<TriangleMeshVolume>(a, b, collisionInfo);
+}
+
+bool CollisionDetection::HeightfieldIntersection(GameObject* a, GameObject* b, CollisionInfo& collisionInfo) {
+	if (a->GetBoundingVolume()->type != VolumeType::Heightfield) {
+		return FlippedIntersection(HeightfieldIntersection, a, b, collisionInfo);
+	}
+	return MeshIntersection<HeightfieldVolume>(a, b, collisionInfo);
+}
+
 bool CollisionDetection::AABBTest(const Vector3& posA, const Vector3& posB, const Vector3& halfSizeA, const Vector3& halfSizeB) {
 	Vector3 delta = posB - posA;
 	Vector3 totalSize = halfSizeA + halfSizeB;
@@ -711,8 +1067,7 @@ bool CollisionDetection::SphereCapsuleIntersection(const CapsuleVolume& volumeA,
 	float capsuleRadius = volumeA.GetRadius();
 
 	Vector3 localupVector(0.0f, 1.0f, 0.0f);
-	Quaternion orientation = worldTransformA.GetOrientation();
-	Matrix3 transform = Matrix3(orientation); //Local to world
+	Matrix3 transform = worldTransformA.GetRotMatrix(); //Local to world
 	//Matrix3 invTransform = Matrix3(orientation.Conjugate()); //World to local
 	Vector3 upVector = (transform * localupVector).Normalised();
 
@@ -756,8 +1111,7 @@ bool NCL::CollisionDetection::CapsuleIntersection(const CapsuleVolume& volumeA,
 	float capsuleRadiusA = volumeA.GetRadius();
 
 	Vector3 localUpVector(0.0f, 1.0f, 0.0f);
-	Quaternion orientationA = worldTransformA.GetOrientation();
-	Matrix3 transformA = Matrix3(orientationA); //Local to world
+	Matrix3 transformA = worldTransformA.GetRotMatrix(); //Local to world
 	//Matrix3 invTransform = Matrix3(orientation.Conjugate()); //World to local
 	Vector3 upVectorA = (transformA * localUpVector).Normalised();
 
@@ -769,8 +1123,7 @@ bool NCL::CollisionDetection::CapsuleIntersection(const CapsuleVolume& volumeA,
 	float capsuleHalfHeightB = volumeB.GetHalfHeight();
 	float capsuleRadiusB = volumeB.GetRadius();
 
-	Quaternion orientationB = worldTransformB.GetOrientation();
-	Matrix3 transformB = Matrix3(orientationB); //Local to world
+	Matrix3 transformB = worldTransformB.GetRotMatrix(); //Local to world
 	//Matrix3 invTransform = Matrix3(orientation.Conjugate()); //World to local
 	Vector3 upVectorB = (transformB * localUpVector).Normalised();
 
@@ -784,15 +1137,21 @@ bool NCL::CollisionDetection::CapsuleIntersection(const CapsuleVolume& volumeA,
 
 
 	float radius = capsuleRadiusA + capsuleRadiusB;
-	if (dist <= radius * radius) {
-		Transform sphereTransformA;
-		sphereTransformA.SetPosition(closestPointA);
-		Transform sphereTransformB;
-		sphereTransformB.SetPosition(closestPointB);
-
-		if (SphereIntersection(SphereVolume(capsuleRadiusA), sphereTransformA, SphereVolume(capsuleRadiusB), sphereTransformB, collisionInfo)) {
-			return true;
+	if (dist < radius * radius) {
+		Vector3 delta = closestPointB - closestPointA;
+		float deltaLength = delta.Length();
+
+		//Axes crossing each other leave no direction to push along, fall back to the centres
+		Vector3 normal = deltaLength > 0.0f ? delta / deltaLength : (capsulePosB - capsulePosA).Normalised();
+		if (normal.LengthSquared() == 0.0f) {
+			normal = Vector3(0, 1, 0);
 		}
+		//Contacts are relative to each capsule's centre, not the point on its axis
+		Vector3 localA = (closestPointA - capsulePosA) + normal * capsuleRadiusA;
+		Vector3 localB = (closestPointB - capsulePosB) - normal * capsuleRadiusB;
+
+		collisionInfo.AddContactPoint(localA, localB, normal, radius - deltaLength);
+		return true;
 	}
 
 	return false;
@@ -924,8 +1283,7 @@ bool NCL::CollisionDetection::MovingSphereAABBIntersection(const AABBVolume& vol
 bool NCL::CollisionDetection::AABBCapsuleIntersection(const AABBVolume& volumeA, const Transform& worldTransformA, const CapsuleVolume& volumeB, const Transform& worldTransformB, CollisionInfo& collisionInfo)
 {
 	Vector3 localupVector(0.0f, 1.0f, 0.0f);
-	Quaternion orientation = worldTransformB.GetOrientation();
-	Matrix3 transform = Matrix3(orientation); //Local to world
+	Matrix3 transform = worldTransformB.GetRotMatrix(); //Local to world
 	//Matrix3 invTransform = Matrix3(orientation.Conjugate()); //World to local
 	Vector3 upVector = (transform * localupVector).Normalised();
 
@@ -963,3 +1321,79 @@ Vector3 NCL::CollisionDetection::BoxCorner(const AABBVolume& volume, const Trans
 
 
 
+/*
+Picks the contacts that keep a manifold stable: the deepest one, the one furthest
+from it, the one making the biggest triangle with those two, and finally the one
+furthest outside that triangle. All points are compared by their offset on object
+A, which is fine as they all share the same frame.
+*/
+void CollisionDetection::ReduceContactPoints(ContactPoint* points, int& numPoints) {
+	if (numPoints <= MAX_CONTACT_POINTS) {
+		return;
+	}
+	Vector3 normal = points[0].normal;
+	int chosen[MAX_CONTACT_POINTS];
+
+	chosen[0] = 0;
+	for (int i = 1; i < numPoints; ++i) {
+		if (points[i].penetration > points[chosen[0]].penetration) {
+			chosen[0] = i;
+		}
+	}
+	const Vector3& p0 = points[chosen[0]].localA;
+
+	float best = -1.0f;
+	for (int i = 0; i < numPoints; ++i) {
+		float distSq = (points[i].localA - p0).LengthSquared();
+		if (distSq > best) {
+			best		= distSq;
+			chosen[1]	= i;
+		}
+	}
+	const Vector3& p1 = points[chosen[1]].localA;
+
+	best = -1.0f;
+	for (int i = 0; i < numPoints; ++i) {
+		float area = fabs(Vector3::Dot(Vector3::Cross(p1 - p0, points[i].localA - p0), normal));
+		if (area > best) {
+			best		= area;
+			chosen[2]	= i;
+		}
+	}
+	const Vector3& p2 = points[chosen[2]].localA;
+
+	//Signed areas against each edge of the triangle, flipped so outside is positive
+	float winding = (Vector3::Dot(Vector3::Cross(p1 - p0, p2 - p0), normal) < 0) ? 1.0f : -1.0f;
+	const Vector3* triangle[3] = { &p0, &p1, &p2 };
+	best = -1.0f;
+	for (int i = 0; i < numPoints; ++i) {
+		float outside = -FLT_MAX;
+		for (int e = 0; e < 3; ++e) {
+			const Vector3& from = *triangle[e];
+			const Vector3& to	= *triangle[(e + 1) % 3];
+			float area = winding * Vector3::Dot(Vector3::Cross(to - from, points[i].localA - from), normal);
+			outside = max(outside, area);
+		}
+		if (outside > best) {
+			best		= outside;
+			chosen[3]	= i;
+		}
+	}
+
+	//Degenerate sets (all points on a line) can pick the same point twice
+	ContactPoint reduced[MAX_CONTACT_POINTS];
+	int numReduced = 0;
+	for (int i = 0; i < MAX_CONTACT_POINTS; ++i) {
+		bool duplicate = false;
+		for (int j = 0; j < i; ++j) {
+			duplicate |= (chosen[j] == chosen[i]);
+		}
+		if (!duplicate) {
+			reduced[numReduced++] = points[chosen[i]];
+		}
+	}
+	for (int i = 0; i < numReduced; ++i) {
+		points[i] = reduced[i];
+	}
+	numPoints = numReduced;
+}
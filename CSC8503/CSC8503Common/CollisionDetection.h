@@ -14,9 +14,16 @@
 #include "CapsuleVolume.h"
 
 #include "CylinderVolume.h"
+#include "ConvexHullVolume.h"
+#include "CompoundVolume.h"
+#include "TriangleMeshVolume.h"
+#include "HeightfieldVolume.h"
 
 #include "Ray.h"
 
+#define MAX_CONTACT_POINTS 4
+#define NUM_VOLUME_TYPES 16 //one slot per VolumeType bit
+
 using NCL::Camera;
 using namespace NCL::Maths;
 using namespace NCL::CSC8503;
@@ -36,13 +43,28 @@ namespace NCL {
 			mutable int		framesLeft; //? 
 			mutable int staticCount;
 
-			ContactPoint point;
+			ContactPoint point; //deepest contact
+
+			ContactPoint	contacts[MAX_CONTACT_POINTS]; //contact manifold
+			int				numContacts = 0;
 
 			void AddContactPoint(const Vector3& localA, const Vector3& localB, const Vector3& normal, float p) {
-				point.localA		= localA;
-				point.localB		= localB;
-				point.normal		= normal;
-				point.penetration	= p;
+				ContactPoint c;
+				c.localA		= localA;
+				c.localB		= localB;
+				c.normal		= normal;
+				c.penetration	= p;
+
+				if (numContacts == 0 || p > point.penetration) {
+					point = c;
+				}
+				if (numContacts < MAX_CONTACT_POINTS) {
+					contacts[numContacts++] = c;
+				}
+			}
+
+			void ClearContactPoints() {
+				numContacts = 0;
 			}
 
 
@@ -67,12 +89,16 @@ namespace NCL {
 
 
 
+		//Keeps the MAX_CONTACT_POINTS contacts spanning the largest area, always including the deepest one
+		static void ReduceContactPoints(ContactPoint* points, int& numPoints);
+
 		//TODO ADD THIS PROPERLY
 		static bool RayBoxIntersection(const Ray&r, const Vector3& boxPos, const Vector3& boxSize, RayCollision& collision);
 
 		static Ray BuildRayFromMouse(const Camera& c);
 
 		static bool RayIntersection(const Ray&r, GameObject& object, RayCollision &collisions);
+		static bool RayVolumeIntersection(const Ray& r, const Transform& worldTransform, const CollisionVolume& volume, RayCollision& collision);
 
 		static bool RayAABBIntersection(const Ray&r, const Transform& worldTransform, const AABBVolume&	volume, RayCollision& collision);
 		static bool RayOBBIntersection(const Ray&r, const Transform& worldTransform, const OBBVolume&	volume, RayCollision& collision);
@@ -92,6 +118,10 @@ namespace NCL {
 
 		static bool RayCylinderIntersection(const Ray& r, const Transform& worldTransform, const CylinderVolume& volume, RayCollision& collision);
 
+		static bool RayCompoundIntersection(const Ray& r, const Transform& worldTransform, const CompoundVolume& volume, RayCollision& collision);
+		static bool RayTriangleMeshIntersection(const Ray& r, const Transform& worldTransform, const TriangleMeshVolume& volume, RayCollision& collision);
+		static bool RayHeightfieldIntersection(const Ray& r, const Transform& worldTransform, const HeightfieldVolume& volume, RayCollision& collision);
+
 		static bool RayPlaneIntersection(const Ray&r, const Plane&p, RayCollision& collisions);
 
 		static bool	AABBTest(const Vector3& posA, const Vector3& posB, const Vector3& halfSizeA, const Vector3& halfSizeB);
@@ -99,6 +129,25 @@ namespace NCL {
 
 		static bool ObjectIntersection(GameObject* a, GameObject* b, CollisionInfo& collisionInfo);
 
+		//Closed form test for a pair of objects, called with a having the first volume type of its table slot
+		typedef bool (*PairTest)(GameObject* a, GameObject* b, CollisionInfo& collisionInfo);
+
+		//Test registered for a pair of volume types, nullptr if the pair should go through GJK + EPA.
+		//By default sphere/sphere, sphere/capsule and capsule/capsule are done analytically,
+		//compounds against anything go to CompoundIntersection, triangle meshes to TriangleMeshIntersection
+		//and heightfields to HeightfieldIntersection
+		static PairTest GetPairTest(VolumeType a, VolumeType b);
+		static void		SetPairTest(VolumeType a, VolumeType b, PairTest test);
+
+
+		//Either object can be the compound, or both. Each child pair is run through GJK + EPA.
+		static bool CompoundIntersection(GameObject* a, GameObject* b, CollisionInfo& collisionInfo);
+
+		//Either object can be the mesh. Each triangle under the other object is run through GJK + EPA.
+		static bool TriangleMeshIntersection(GameObject* a, GameObject* b, CollisionInfo& collisionInfo);
+
+		//Either object can be the heightfield. Triangles of the cells under the other object are run through GJK + EPA.
+		static bool HeightfieldIntersection(GameObject* a, GameObject* b, CollisionInfo& collisionInfo);
 
 		static bool AABBIntersection(const AABBVolume& volumeA, const Transform& worldTransformA,
 										const AABBVolume& volumeB, const Transform& worldTransformB, CollisionInfo& collisionInfo);
@@ -136,6 +185,16 @@ namespace NCL {
 		static bool SATTest(GameObject* coll1, GameObject* coll2, CollisionDetection::CollisionInfo& collisionInfo);
 
 	protected:
+		static bool SphereSpherePair(GameObject* a, GameObject* b, CollisionInfo& collisionInfo);
+		static bool SphereCapsulePair(GameObject* a, GameObject* b, CollisionInfo& collisionInfo);
+		static bool CapsuleSpherePair(GameObject* a, GameObject* b, CollisionInfo& collisionInfo);
+		static bool CapsuleCapsulePair(GameObject* a, GameObject* b, CollisionInfo& collisionInfo);
+
+		static int	VolumeTypeIndex(VolumeType type);
+		static void BuildPairTable();
+
+		static PairTest pairTable[NUM_VOLUME_TYPES][NUM_VOLUME_TYPES];
+		static bool		pairTableBuilt;
 	
 	private:
 		CollisionDetection()	{}
@@ -8,6 +8,8 @@
 //#include "../CSC8503Common/GameObject.h"
 //#include "../CSC8503Common/CollisionDetection.h"
 
+#define MAX_FEATURE_POINTS 4
+
 namespace NCL {
 
 	//using namespace NCL::Maths;
@@ -22,7 +24,9 @@ namespace NCL {
 		Capsule = 16,
 		Compound= 32,
 		Cylinder= 64,
-		Invalid = 256
+		TriangleMesh = 128,
+		Invalid = 256,
+		Heightfield = 512
 	};
 
 	class CollisionVolume
@@ -31,7 +35,7 @@ namespace NCL {
 		CollisionVolume() {
 			type = VolumeType::Invalid;
 		}
-		~CollisionVolume() {}
+		virtual ~CollisionVolume() {} //compound volumes delete their children through this
 
 		VolumeType type;
 
@@ -40,6 +44,48 @@ namespace NCL {
 
 		virtual Vector3 Support(const Vector3& dir, const Transform& transform) = 0;
 
+		//Rounded shapes are a core shape grown by a margin (a sphere is a point grown by its radius).
+		//GJK can work on the cores, which have no curved surface to chase, and add the margin back on after.
+		virtual float GetMargin() const {
+			return 0.0f;
+		}
+		virtual Vector3 CoreSupport(const Vector3& dir, const Transform& transform) {
+			return Support(dir, transform);
+		}
+
+		//World space vertices of the feature (face, edge or vertex) pointing furthest along dir, used to
+		//clip multi point contact manifolds. Shapes without flat features just return their support point.
+		virtual int GetFeature(const Vector3& dir, const Transform& transform, Vector3* points) {
+			points[0] = Support(dir, transform);
+			return 1;
+		}
+
+	protected:
+		//Face of a box most aligned with dir, as a loop of 4 vertices
+		static int GetBoxFeature(const Vector3& halfSizes, const Vector3& dir, const Transform& transform, Vector3* points) {
+			Vector3 localDir = transform.GetInvRotMatrix() * dir;
+
+			int axis = 0;
+			for (int i = 1; i < 3; ++i) {
+				if (fabs(localDir.array[i]) > fabs(localDir.array[axis])) {
+					axis = i;
+				}
+			}
+			int u = (axis + 1) % 3;
+			int v = (axis + 2) % 3;
+
+			static const float corners[4][2] = { {1, 1}, {-1, 1}, {-1, -1}, {1, -1} };
+			Matrix3 rot = transform.GetRotMatrix();
+			for (int i = 0; i < 4; ++i) {
+				Vector3 corner;
+				corner.array[axis]	= (localDir.array[axis] > 0) ? halfSizes.array[axis] : -halfSizes.array[axis];
+				corner.array[u]		= corners[i][0] * halfSizes.array[u];
+				corner.array[v]		= corners[i][1] * halfSizes.array[v];
+				points[i] = rot * corner + transform.GetPosition();
+			}
+			return 4;
+		}
+
 		
 	};
 }
\ No newline at end of file
@@ -0,0 +1,205 @@
+#include "CompoundVolume.h"
+#include <algorithm>
+#include <cfloat>
+
+using namespace NCL;
+
+#define COMPOUND_MAX_DEPTH 64 //traversal stack, the tree is balanced so this is never close
+
+CompoundVolume::CompoundVolume() {
+	type = VolumeType::Compound;
+}
+
+CompoundVolume::~CompoundVolume() {
+	for (Child& c : children) {
+		delete c.volume;
+	}
+}
+
+void CompoundVolume::AddChild(CollisionVolume* volume, const Vector3& offset, const Quaternion& orientation) {
+	Child c;
+	c.volume		= volume;
+	c.offset		= offset;
+	c.orientation	= orientation;
+
+	//The support points along each axis give the tightest box around any convex volume
+	Transform local;
+	local.SetPosition(offset).SetOrientation(orientation);
+	for (int axis = 0; axis < 3; ++axis) {
+		Vector3 dir;
+		dir.array[axis] = 1.0f;
+		c.boundsMax.array[axis] = volume->Support(dir, local).array[axis];
+		c.boundsMin.array[axis] = volume->Support(-dir, local).array[axis];
+	}
+	children.push_back(c);
+
+	BuildTree(); //children are only added while setting up, and there aren't many of them
+}
+
+Transform CompoundVolume::GetChildTransform(int i, const Transform& transform) const {
+	const Child& c = children[i];
+	Transform world;
+	world.SetPosition(transform.GetPosition() + transform.GetRotMatrix() * c.offset)
+		.SetOrientation(transform.GetOrientation() * c.orientation);
+	return world;
+}
+
+Vector3 CompoundVolume::GetLocalCentre() const {
+	if (nodes.empty()) {
+		return Vector3();
+	}
+	return (nodes[0].boundsMin + nodes[0].boundsMax) * 0.5f;
+}
+
+Vector3 CompoundVolume::GetLocalHalfSizes() const {
+	if (nodes.empty()) {
+		return Vector3();
+	}
+	return (nodes[0].boundsMax - nodes[0].boundsMin) * 0.5f;
+}
+
+Vector3 CompoundVolume::Support(const Vector3& dir, const Transform& transform) {
+	Vector3 best	= transform.GetPosition();
+	float	bestDot = -FLT_MAX;
+	for (int i = 0; i < (int)children.size(); ++i) {
+		Vector3 p = children[i].volume->Support(dir, GetChildTransform(i, transform));
+		float	d = Vector3::Dot(p, dir);
+		if (d > bestDot) {
+			bestDot = d;
+			best	= p;
+		}
+	}
+	return best;
+}
+
+static bool BoxesOverlap(const Vector3& minA, const Vector3& maxA, const Vector3& minB, const Vector3& maxB) {
+	return	minA.x <= maxB.x && maxA.x >= minB.x &&
+			minA.y <= maxB.y && maxA.y >= minB.y &&
+			minA.z <= maxB.z && maxA.z >= minB.z;
+}
+
+void CompoundVolume::GetOverlappingChildren(const Vector3& boxMin, const Vector3& boxMax, std::vector<int>& overlapping) const {
+	overlapping.clear();
+	if (nodes.empty()) {
+		return;
+	}
+	int stack[COMPOUND_MAX_DEPTH];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0) {
+		const Node& n = nodes[stack[--stackSize]];
+		if (!BoxesOverlap(n.boundsMin, n.boundsMax, boxMin, boxMax)) {
+			continue;
+		}
+		if (n.left < 0) {
+			overlapping.push_back(n.child);
+			continue;
+		}
+		stack[stackSize++] = n.left;
+		stack[stackSize++] = n.right;
+	}
+}
+
+void CompoundVolume::GetChildrenOnRay(const Vector3& rayPos, const Vector3& rayDir, float maxDistance, std::vector<int>& hit) const {
+	hit.clear();
+	if (nodes.empty()) {
+		return;
+	}
+	int stack[COMPOUND_MAX_DEPTH];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0) {
+		const Node& n = nodes[stack[--stackSize]];
+
+		//Slab test, clipping the ray to each pair of planes in turn
+		float tMin = 0.0f;
+		float tMax = maxDistance;
+		for (int axis = 0; axis < 3 && tMin <= tMax; ++axis) {
+			if (rayDir.array[axis] == 0.0f) {
+				if (rayPos.array[axis] < n.boundsMin.array[axis] || rayPos.array[axis] > n.boundsMax.array[axis]) {
+					tMin = FLT_MAX;
+				}
+				continue;
+			}
+			float invDir	= 1.0f / rayDir.array[axis];
+			float t0		= (n.boundsMin.array[axis] - rayPos.array[axis]) * invDir;
+			float t1		= (n.boundsMax.array[axis] - rayPos.array[axis]) * invDir;
+			if (t0 > t1) {
+				std::swap(t0, t1);
+			}
+			tMin = std::max(tMin, t0);
+			tMax = std::min(tMax, t1);
+		}
+		if (tMin > tMax) {
+			continue;
+		}
+		if (n.left < 0) {
+			hit.push_back(n.child);
+			continue;
+		}
+		stack[stackSize++] = n.left;
+		stack[stackSize++] = n.right;
+	}
+}
+
+void CompoundVolume::BuildTree() {
+	nodes.clear();
+	if (children.empty()) {
+		return;
+	}
+	nodes.reserve(children.size() * 2 - 1);
+
+	std::vector<int> indices(children.size());
+	for (int i = 0; i < (int)indices.size(); ++i) {
+		indices[i] = i;
+	}
+	BuildNode(indices.data(), (int)indices.size());
+}
+
+//Top down, splitting at the median child along the axis the children's centres are most spread out on
+int CompoundVolume::BuildNode(int* indices, int count) {
+	int index = (int)nodes.size();
+	nodes.push_back(Node());
+
+	Vector3 boundsMin = children[indices[0]].boundsMin;
+	Vector3 boundsMax = children[indices[0]].boundsMax;
+	Vector3 centreMin = (children[indices[0]].boundsMin + children[indices[0]].boundsMax) * 0.5f;
+	Vector3 centreMax = centreMin;
+	for (int i = 1; i < count; ++i) {
+		const Child& c = children[indices[i]];
+		Vector3 centre = (c.boundsMin + c.boundsMax) * 0.5f;
+		for (int axis = 0; axis < 3; ++axis) {
+			boundsMin.array[axis] = std::min(boundsMin.array[axis], c.boundsMin.array[axis]);
+			boundsMax.array[axis] = std::max(boundsMax.array[axis], c.boundsMax.array[axis]);
+			centreMin.array[axis] = std::min(centreMin.array[axis], centre.array[axis]);
+			centreMax.array[axis] = std::max(centreMax.array[axis], centre.array[axis]);
+		}
+	}
+	nodes[index].boundsMin = boundsMin;
+	nodes[index].boundsMax = boundsMax;
+
+	if (count == 1) {
+		nodes[index].left	= -1;
+		nodes[index].right	= -1;
+		nodes[index].child	= indices[0];
+		return index;
+	}
+
+	Vector3 spread = centreMax - centreMin;
+	int axis = 0;
+	if (spread.y > spread.array[axis]) axis = 1;
+	if (spread.z > spread.array[axis]) axis = 2;
+
+	int half = count / 2;
+	std::nth_element(indices, indices + half, indices + count, [&](int a, int b) {
+		return	children[a].boundsMin.array[axis] + children[a].boundsMax.array[axis] <
+				children[b].boundsMin.array[axis] + children[b].boundsMax.array[axis];
+	});
+
+	int left	= BuildNode(indices, half);
+	int right	= BuildNode(indices + half, count - half);
+	nodes[index].left	= left;
+	nodes[index].right	= right;
+	nodes[index].child	= -1;
+	return index;
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include "CollisionVolume.h"
+#include "../../Common/Vector3.h"
+#include "../../Common/Quaternion.h"
+#include <vector>
+
+namespace NCL {
+	/*
+	A rigid group of volumes, each placed at an offset (and orientation) from the object.
+	One GameObject with a compound replaces several objects held together by constraints,
+	so there's one body for the solver and one box for the broadphase.
+
+	The children's bounds, in the compound's space, are kept in a small AABB tree, so a
+	query against another shape only reaches the children whose bounds it overlaps.
+	Children are owned by the compound and deleted with it.
+	*/
+	class CompoundVolume : public CollisionVolume
+	{
+	public:
+		CompoundVolume();
+		~CompoundVolume();
+
+		//offset and orientation are relative to the object the compound belongs to
+		void AddChild(CollisionVolume* volume, const Vector3& offset, const Quaternion& orientation = Quaternion());
+
+		int GetNumChildren() const {
+			return (int)children.size();
+		}
+
+		CollisionVolume* GetChildVolume(int i) const {
+			return children[i].volume;
+		}
+
+		//Where child i is in the world, for an object at transform
+		Transform GetChildTransform(int i, const Transform& transform) const;
+
+		//Bounds of child i in the compound's space
+		void GetChildBounds(int i, Vector3& boundsMin, Vector3& boundsMax) const {
+			boundsMin = children[i].boundsMin;
+			boundsMax = children[i].boundsMax;
+		}
+
+		//Children whose bounds overlap the box, which is in the compound's space
+		void GetOverlappingChildren(const Vector3& boxMin, const Vector3& boxMax, std::vector<int>& overlapping) const;
+
+		//Children whose bounds the ray passes through within maxDistance, the ray being in the compound's space
+		void GetChildrenOnRay(const Vector3& rayPos, const Vector3& rayDir, float maxDistance, std::vector<int>& hit) const;
+
+		//Bounds of all the children, which needn't be centred on the object
+		Vector3 GetLocalCentre() const;
+		Vector3 GetLocalHalfSizes() const;
+
+		//Support of the hull around all the children. A compound needn't be convex, so this is only
+		//good for bounds; collisions are done child by child.
+		Vector3 Support(const Vector3& dir, const Transform& transform);
+
+	protected:
+		struct Child {
+			CollisionVolume*	volume;
+			Vector3				offset;
+			Quaternion			orientation;
+			Vector3				boundsMin;
+			Vector3				boundsMax;
+		};
+
+		struct Node {
+			Vector3 boundsMin;
+			Vector3 boundsMax;
+			int		left;	//-1 for a leaf
+			int		right;
+			int		child;	//only for leaves
+		};
+
+		void BuildTree();
+		int	 BuildNode(int* indices, int count);
+
+		std::vector<Child>	children;
+		std::vector<Node>	nodes;	//nodes[0] is the root
+	};
+}
@@ -0,0 +1,73 @@
+#include "ContactManifold.h"
+#include "GameObject.h"
+
+using namespace NCL;
+using namespace NCL::CSC8503;
+
+void ContactManifold::Update(GameObject* a, GameObject* b, const CollisionDetection::ContactPoint& newPoint) {
+	//A new normal means the objects are touching on different features now, old contacts are meaningless
+	if (numPoints > 0 && Vector3::Dot(points[0].normal, newPoint.normal) < 0.95f) {
+		numPoints = 0;
+	}
+	Refresh(a, b, newPoint.normal);
+
+	int slot = numPoints;
+	for (int i = 0; i < numPoints; ++i) {
+		if ((points[i].localA - newPoint.localA).LengthSquared() < CONTACT_MERGE_DISTANCE * CONTACT_MERGE_DISTANCE) {
+			slot = i; //same contact as last frame, replace it with the fresh one
+			break;
+		}
+	}
+	points[slot] = newPoint;
+	if (slot == numPoints) {
+		numPoints++;
+	}
+
+	CollisionDetection::ReduceContactPoints(points, numPoints);
+	StoreModelSpace(a, b);
+}
+
+void ContactManifold::GetContacts(CollisionDetection::CollisionInfo& info) const {
+	info.ClearContactPoints();
+	for (int i = 0; i < numPoints; ++i) {
+		info.AddContactPoint(points[i].localA, points[i].localB, points[i].normal, points[i].penetration);
+	}
+}
+
+void ContactManifold::Refresh(GameObject* a, GameObject* b, const Vector3& normal) {
+	const Transform& transformA = a->GetTransform();
+	const Transform& transformB = b->GetTransform();
+	Matrix3 rotA = transformA.GetRotMatrix();
+	Matrix3 rotB = transformB.GetRotMatrix();
+
+	int kept = 0;
+	for (int i = 0; i < numPoints; ++i) {
+		Vector3 localA = rotA * modelA[i];
+		Vector3 localB = rotB * modelB[i];
+		Vector3 offset = (localA + transformA.GetPosition()) - (localB + transformB.GetPosition());
+
+		float penetration	= Vector3::Dot(offset, normal);
+		Vector3 drift		= offset - normal * penetration;
+
+		if (penetration < -CONTACT_BREAKING_DISTANCE || drift.LengthSquared() > CONTACT_BREAKING_DISTANCE * CONTACT_BREAKING_DISTANCE) {
+			continue; //pulled apart, or slid too far to still be the same contact
+		}
+		points[kept].localA			= localA;
+		points[kept].localB			= localB;
+		points[kept].normal			= normal;
+		points[kept].penetration	= penetration;
+		modelA[kept] = modelA[i];
+		modelB[kept] = modelB[i];
+		kept++;
+	}
+	numPoints = kept;
+}
+
+void ContactManifold::StoreModelSpace(GameObject* a, GameObject* b) {
+	Matrix3 invRotA = a->GetTransform().GetInvRotMatrix();
+	Matrix3 invRotB = b->GetTransform().GetInvRotMatrix();
+	for (int i = 0; i < numPoints; ++i) {
+		modelA[i] = invRotA * points[i].localA;
+		modelB[i] = invRotB * points[i].localB;
+	}
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include "CollisionDetection.h"
+
+#define CONTACT_BREAKING_DISTANCE 0.05f	//how far a stored contact may drift apart before it's dropped
+#define CONTACT_MERGE_DISTANCE 0.05f	//new contacts closer than this to a stored one replace it
+
+namespace NCL {
+	namespace CSC8503 {
+		class GameObject;
+
+		/*
+		Contact points of a pair, kept across frames. Every frame EPA only gives a
+		single new contact; the older ones are moved along with the objects (they're
+		stored in each object's model space) and kept as long as they're still touching,
+		so after a few frames a resting box has its full 4 point manifold back.
+		*/
+		class ContactManifold
+		{
+		public:
+			ContactManifold() {
+				numPoints		= 0;
+				framesUnused	= 0;
+			}
+			~ContactManifold() {}
+
+			//Moves the stored contacts to the current transforms, drops the ones that have come apart,
+			//then adds newPoint, keeping the 4 best
+			void Update(GameObject* a, GameObject* b, const CollisionDetection::ContactPoint& newPoint);
+
+			//Replaces the contacts of info with the manifold
+			void GetContacts(CollisionDetection::CollisionInfo& info) const;
+
+			void Clear() {
+				numPoints = 0;
+			}
+
+			int GetNumPoints() const {
+				return numPoints;
+			}
+
+			int framesUnused; //Frames since the pair last touched, used to evict stale manifolds
+
+		protected:
+			void Refresh(GameObject* a, GameObject* b, const Vector3& normal);
+			void StoreModelSpace(GameObject* a, GameObject* b);
+
+			CollisionDetection::ContactPoint points[MAX_CONTACT_POINTS + 1]; //room for one new point before reducing
+			Vector3 modelA[MAX_CONTACT_POINTS + 1];	//contact on A, in A's model space
+			Vector3 modelB[MAX_CONTACT_POINTS + 1];	//contact on B, in B's model space
+			int		numPoints;
+		};
+	}
+}
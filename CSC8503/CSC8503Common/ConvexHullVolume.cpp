@@ -0,0 +1,319 @@
+#include "ConvexHullVolume.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <random>
+
+using namespace NCL;
+
+#define HULL_TOLERANCE 0.00001f //relative to the size of the point cloud
+
+ConvexHullVolume::ConvexHullVolume(const std::vector<Vector3>& points, const Vector3& scale) {
+	type		= VolumeType::Mesh;
+	lastSupport = 0;
+
+	std::vector<Vector3> scaled;
+	scaled.reserve(points.size());
+	for (const Vector3& p : points) {
+		scaled.push_back(p * scale);
+	}
+	BuildHull(scaled);
+	BuildAdjacency();
+}
+
+Vector3 ConvexHullVolume::Support(const Vector3& dir, const Transform& transform) {
+	Vector3 localDir = transform.GetInvRotMatrix() * dir; //find support in model space
+	return transform.GetRotMatrix() * vertices[ClimbToSupport(localDir)] + transform.GetPosition();
+}
+
+int ConvexHullVolume::ClimbToSupport(const Vector3& localDir) {
+	if (faces.empty()) {
+		//Flat point set, there's no surface to climb over
+		int best = 0;
+		for (int i = 1; i < (int)vertices.size(); ++i) {
+			if (Vector3::Dot(vertices[i], localDir) > Vector3::Dot(vertices[best], localDir)) {
+				best = i;
+			}
+		}
+		return best;
+	}
+	int		best	= lastSupport;
+	float	bestDot = Vector3::Dot(vertices[best], localDir);
+	for (;;) {
+		int next = best;
+		for (int i = adjacencyStart[best]; i < adjacencyStart[best + 1]; ++i) {
+			float d = Vector3::Dot(vertices[adjacency[i]], localDir);
+			if (d > bestDot) {
+				bestDot = d;
+				next	= adjacency[i];
+			}
+		}
+		if (next == best) {
+			break; //no neighbour is further along, and on a convex hull that means none is
+		}
+		best = next;
+	}
+	lastSupport = best;
+	return best;
+}
+
+int ConvexHullVolume::GetFeature(const Vector3& dir, const Transform& transform, Vector3* points) {
+	Vector3 localDir = (transform.GetInvRotMatrix() * dir).Normalised();
+	int support = ClimbToSupport(localDir);
+
+	//The face the feature lies in is one of the faces around the support vertex
+	int		bestFace	= -1;
+	float	bestAlign	= -FLT_MAX;
+	for (int i = faceStart[support]; i < faceStart[support + 1]; ++i) {
+		float align = Vector3::Dot(faces[vertexFaces[i]].normal, localDir);
+		if (align > bestAlign) {
+			bestAlign	= align;
+			bestFace	= vertexFaces[i];
+		}
+	}
+	Matrix3 rot = transform.GetRotMatrix();
+	if (bestFace < 0) {
+		points[0] = rot * vertices[support] + transform.GetPosition();
+		return 1;
+	}
+
+	//Hulls of meshes are made of triangles, but flat sides are split into several of them.
+	//Flood out over the vertices in the plane of the face to get the whole polygon.
+	const Face& face = faces[bestFace];
+	int polygon[MAX_FEATURE_POINTS + 1];
+	int numPoints = 0;
+	for (int i = 0; i < 3; ++i) {
+		polygon[numPoints++] = face.v[i];
+	}
+	for (int i = 0; i < numPoints && numPoints <= MAX_FEATURE_POINTS; ++i) {
+		int v = polygon[i];
+		for (int j = adjacencyStart[v]; j < adjacencyStart[v + 1] && numPoints <= MAX_FEATURE_POINTS; ++j) {
+			int n = adjacency[j];
+			if (std::find(polygon, polygon + numPoints, n) != polygon + numPoints) {
+				continue;
+			}
+			if (fabs(Vector3::Dot(face.normal, vertices[n]) - face.distance) < planeTolerance) {
+				polygon[numPoints++] = n;
+			}
+		}
+	}
+	if (numPoints > MAX_FEATURE_POINTS) {
+		numPoints = 3; //too many corners to hand back, the triangle will have to do
+	}
+
+	//Put the corners in order around the face
+	Vector3 centre;
+	for (int i = 0; i < numPoints; ++i) {
+		centre += vertices[polygon[i]];
+	}
+	centre = centre / (float)numPoints;
+	Vector3 u = (vertices[polygon[0]] - centre).Normalised();
+	Vector3 w = Vector3::Cross(face.normal, u);
+
+	float angles[MAX_FEATURE_POINTS + 1];
+	for (int i = 0; i < numPoints; ++i) {
+		Vector3 offset = vertices[polygon[i]] - centre;
+		angles[i] = atan2(Vector3::Dot(offset, w), Vector3::Dot(offset, u));
+	}
+	for (int i = 1; i < numPoints; ++i) {
+		for (int j = i; j > 0 && angles[j] < angles[j - 1]; --j) {
+			std::swap(angles[j], angles[j - 1]);
+			std::swap(polygon[j], polygon[j - 1]);
+		}
+	}
+
+	for (int i = 0; i < numPoints; ++i) {
+		points[i] = rot * vertices[polygon[i]] + transform.GetPosition();
+	}
+	return numPoints;
+}
+
+void ConvexHullVolume::MakeFace(int a, int b, int c, const std::vector<Vector3>& points) {
+	Face f;
+	f.v[0] = a;
+	f.v[1] = b;
+	f.v[2] = c;
+	f.normal	= Vector3::Cross(points[b] - points[a], points[c] - points[a]).Normalised();
+	f.distance	= Vector3::Dot(f.normal, points[a]);
+	faces.push_back(f);
+}
+
+/*
+Incremental hull: start from a tetrahedron of extreme points, then add the other points
+one at a time. Each point outside the hull removes the faces it can see, and the hole is
+filled with a fan of triangles from the point to the edges around the hole (the horizon).
+It's O(points x faces), which is fine as it's only ever run when a volume is made.
+*/
+void ConvexHullVolume::BuildHull(std::vector<Vector3>& points) {
+	faces.clear();
+	vertices.clear();
+
+	//Meshes repeat positions for every UV seam and normal split, drop the copies
+	std::sort(points.begin(), points.end(), [](const Vector3& a, const Vector3& b) {
+		return a.x < b.x || (a.x == b.x && (a.y < b.y || (a.y == b.y && a.z < b.z)));
+	});
+	points.erase(std::unique(points.begin(), points.end()), points.end());
+
+	localMin = Vector3(FLT_MAX, FLT_MAX, FLT_MAX);
+	localMax = Vector3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for (const Vector3& p : points) {
+		localMin = Vector3(std::min(localMin.x, p.x), std::min(localMin.y, p.y), std::min(localMin.z, p.z));
+		localMax = Vector3(std::max(localMax.x, p.x), std::max(localMax.y, p.y), std::max(localMax.z, p.z));
+	}
+	if (points.empty()) {
+		localMin = localMax = Vector3();
+		vertices.push_back(Vector3());
+		return;
+	}
+	Vector3 size = localMax - localMin;
+	planeTolerance = std::max(std::max(size.x, size.y), size.z) * HULL_TOLERANCE;
+
+	//Starting tetrahedron: the two points furthest apart along an axis, the point furthest
+	//from the line between them, and the point furthest from the plane of those three
+	int i0 = 0;
+	int i1 = 0;
+	float bestSpread = -1.0f;
+	for (int axis = 0; axis < 3; ++axis) {
+		int lo = 0;
+		int hi = 0;
+		for (int i = 1; i < (int)points.size(); ++i) {
+			if (points[i].array[axis] < points[lo].array[axis]) lo = i;
+			if (points[i].array[axis] > points[hi].array[axis]) hi = i;
+		}
+		float spread = points[hi].array[axis] - points[lo].array[axis];
+		if (spread > bestSpread) {
+			bestSpread	= spread;
+			i0			= lo;
+			i1			= hi;
+		}
+	}
+	int i2 = -1;
+	float bestDist = planeTolerance;
+	Vector3 line = points[i1] - points[i0];
+	for (int i = 0; i < (int)points.size(); ++i) {
+		float dist = Vector3::Cross(points[i] - points[i0], line).Length();
+		if (dist > bestDist) {
+			bestDist	= dist;
+			i2			= i;
+		}
+	}
+	int i3 = -1;
+	if (i2 >= 0) {
+		Vector3 planeNormal = Vector3::Cross(line, points[i2] - points[i0]).Normalised();
+		bestDist = planeTolerance;
+		for (int i = 0; i < (int)points.size(); ++i) {
+			float dist = fabs(Vector3::Dot(points[i] - points[i0], planeNormal));
+			if (dist > bestDist) {
+				bestDist	= dist;
+				i3			= i;
+			}
+		}
+	}
+	if (i3 < 0) {
+		//Flat or a line, there's no hull to build. Keep the points, Support will just scan them.
+		vertices = points;
+		return;
+	}
+
+	//Wind the tetrahedron so its faces point away from the opposite vertex
+	if (Vector3::Dot(Vector3::Cross(points[i1] - points[i0], points[i2] - points[i0]), points[i3] - points[i0]) > 0) {
+		std::swap(i1, i2);
+	}
+	MakeFace(i0, i1, i2, points);
+	MakeFace(i0, i3, i1, points);
+	MakeFace(i1, i3, i2, points);
+	MakeFace(i2, i3, i0, points);
+
+	//The points are sorted now, and adding them in that order sweeps across the mesh with
+	//nearly every point on the hull so far. In a shuffled order most land inside early on.
+	std::vector<int> order(points.size());
+	for (int i = 0; i < (int)order.size(); ++i) {
+		order[i] = i;
+	}
+	std::shuffle(order.begin(), order.end(), std::mt19937(12345));
+
+	std::vector<int>				visible;
+	std::vector<std::pair<int, int>> edges;
+	std::vector<std::pair<int, int>> horizon;
+	for (int p : order) {
+		if (p == i0 || p == i1 || p == i2 || p == i3) {
+			continue;
+		}
+		visible.clear();
+		for (int f = 0; f < (int)faces.size(); ++f) {
+			if (Vector3::Dot(faces[f].normal, points[p]) - faces[f].distance > planeTolerance) {
+				visible.push_back(f);
+			}
+		}
+		if (visible.empty()) {
+			continue; //inside the hull so far
+		}
+
+		//Edges of the visible faces that aren't shared with another visible face are the horizon
+		edges.clear();
+		for (int f : visible) {
+			for (int i = 0; i < 3; ++i) {
+				edges.push_back({ faces[f].v[i], faces[f].v[(i + 1) % 3] });
+			}
+		}
+		std::sort(edges.begin(), edges.end());
+		horizon.clear();
+		for (const std::pair<int, int>& e : edges) {
+			if (!std::binary_search(edges.begin(), edges.end(), std::make_pair(e.second, e.first))) {
+				horizon.push_back(e);
+			}
+		}
+
+		for (int i = (int)visible.size() - 1; i >= 0; --i) { //visible is in ascending order
+			faces[visible[i]] = faces.back();
+			faces.pop_back();
+		}
+		for (const std::pair<int, int>& e : horizon) {
+			MakeFace(e.first, e.second, p, points);
+		}
+	}
+
+	//Only keep the points the hull ended up using
+	std::vector<int> remap(points.size(), -1);
+	for (Face& f : faces) {
+		for (int i = 0; i < 3; ++i) {
+			if (remap[f.v[i]] < 0) {
+				remap[f.v[i]] = (int)vertices.size();
+				vertices.push_back(points[f.v[i]]);
+			}
+			f.v[i] = remap[f.v[i]];
+		}
+	}
+}
+
+void ConvexHullVolume::BuildAdjacency() {
+	int numVertices = (int)vertices.size();
+	adjacencyStart.assign(numVertices + 1, 0);
+	faceStart.assign(numVertices + 1, 0);
+	adjacency.clear();
+	vertexFaces.clear();
+
+	//Every edge is in two faces, once each way round, so each face edge (a, b) gives a exactly one neighbour
+	for (const Face& f : faces) {
+		for (int i = 0; i < 3; ++i) {
+			adjacencyStart[f.v[i] + 1]++;
+			faceStart[f.v[i] + 1]++;
+		}
+	}
+	for (int i = 0; i < numVertices; ++i) {
+		adjacencyStart[i + 1]	+= adjacencyStart[i];
+		faceStart[i + 1]		+= faceStart[i];
+	}
+	adjacency.resize(adjacencyStart[numVertices]);
+	vertexFaces.resize(faceStart[numVertices]);
+
+	std::vector<int> adjacencyFill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+	std::vector<int> faceFill(faceStart.begin(), faceStart.end() - 1);
+	for (int f = 0; f < (int)faces.size(); ++f) {
+		for (int i = 0; i < 3; ++i) {
+			int a = faces[f].v[i];
+			adjacency[adjacencyFill[a]++]	= faces[f].v[(i + 1) % 3];
+			vertexFaces[faceFill[a]++]		= f;
+		}
+	}
+}
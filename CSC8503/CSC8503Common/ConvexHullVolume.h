@@ -0,0 +1,72 @@
+#pragma once
+#include "CollisionVolume.h"
+#include "../../Common/Vector3.h"
+#include <vector>
+
+namespace NCL {
+	/*
+	Convex hull of a set of points, usually a mesh's vertices (MeshGeometry::GetPositionData).
+	The hull is built once, up front, and each hull vertex keeps a list of the vertices it
+	shares an edge with. Support then doesn't scan every vertex: it starts at the vertex
+	that was the answer last time and walks to whichever neighbour is further along dir,
+	until none is. On a convex hull that can only stop at the furthest vertex, and as GJK
+	asks for directions close to the last one, it's usually only a step or two away.
+	*/
+	class ConvexHullVolume : public CollisionVolume
+	{
+	public:
+		//scale is applied to the points, as the render scale on the transform isn't used by collisions
+		ConvexHullVolume(const std::vector<Vector3>& points, const Vector3& scale = Vector3(1, 1, 1));
+		~ConvexHullVolume() {}
+
+		Vector3 Support(const Vector3& dir, const Transform& transform);
+
+		//Polygon of the hull facing dir, if it has no more than MAX_FEATURE_POINTS corners
+		int GetFeature(const Vector3& dir, const Transform& transform, Vector3* points);
+
+		const std::vector<Vector3>& GetVertices() const {
+			return vertices;
+		}
+
+		int GetNumFaces() const {
+			return (int)faces.size();
+		}
+
+		//Model space bounds of the hull, which needn't be centred on the object's position
+		Vector3 GetLocalCentre() const {
+			return (localMin + localMax) * 0.5f;
+		}
+
+		Vector3 GetLocalHalfSizes() const {
+			return (localMax - localMin) * 0.5f;
+		}
+
+	protected:
+		struct Face {
+			int		v[3];		//counter clockwise seen from outside
+			Vector3 normal;
+			float	distance;
+		};
+
+		void BuildHull(std::vector<Vector3>& points);
+		void BuildAdjacency();
+		void MakeFace(int a, int b, int c, const std::vector<Vector3>& points);
+
+		int ClimbToSupport(const Vector3& localDir);
+
+		std::vector<Vector3>	vertices;
+		std::vector<Face>		faces;
+
+		//Neighbours of vertex i are adjacency[adjacencyStart[i]] up to adjacency[adjacencyStart[i + 1]],
+		//and the faces around it are vertexFaces[faceStart[i]] up to vertexFaces[faceStart[i + 1]]
+		std::vector<int>		adjacencyStart;
+		std::vector<int>		adjacency;
+		std::vector<int>		faceStart;
+		std::vector<int>		vertexFaces;
+
+		Vector3 localMin;
+		Vector3 localMax;
+		float	planeTolerance;	//points this close to a face plane are treated as on it
+		int		lastSupport;	//where the next hill climb starts
+	};
+}
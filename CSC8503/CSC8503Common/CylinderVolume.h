@@ -1,6 +1,10 @@
 #pragma once
 #include "CollisionVolume.h"
 #include "../../Common/Vector3.h"
+#include <algorithm>
+
+#define CYLINDER_MARGIN 0.04f //rounds off the rim of the core a little, small enough not to be noticed
+
 namespace NCL {
     class CylinderVolume : public CollisionVolume
     {
@@ -31,6 +35,46 @@ namespace NCL {
 			return transform.GetRotMatrix() * result + transform.GetPosition(); //convert support to world space
 		}
 
+		//A cap facing dir is approximated by 4 points on its rim, a side lying flat by a line
+		int GetFeature(const Vector3& dir, const Transform& transform, Vector3* points) {
+			Vector3 localDir = transform.GetInvRotMatrix() * dir;
+			localDir.Normalise();
+			Matrix3 rot = transform.GetRotMatrix();
+
+			if (fabs(localDir.y) > 0.95f) {
+				float capY = (localDir.y > 0) ? halfHeight : -halfHeight;
+				points[0] = rot * Vector3(radius, capY, 0) + transform.GetPosition();
+				points[1] = rot * Vector3(0, capY, radius) + transform.GetPosition();
+				points[2] = rot * Vector3(-radius, capY, 0) + transform.GetPosition();
+				points[3] = rot * Vector3(0, capY, -radius) + transform.GetPosition();
+				return 4;
+			}
+			if (fabs(localDir.y) < 0.05f) {
+				Vector3 offset = Vector3(localDir.x, 0, localDir.z).Normalised() * radius;
+				points[0] = rot * (offset + Vector3(0, halfHeight, 0)) + transform.GetPosition();
+				points[1] = rot * (offset - Vector3(0, halfHeight, 0)) + transform.GetPosition();
+				return 2;
+			}
+			points[0] = Support(dir, transform);
+			return 1;
+		}
+
+		//Unlike a capsule only a thin skin of a cylinder is rounded, it keeps its flat caps
+		float GetMargin() const {
+			return (std::min)(CYLINDER_MARGIN, 0.5f * (std::min)(radius, halfHeight));
+		}
+
+		//Core is the cylinder shrunk by the margin all round
+		Vector3 CoreSupport(const Vector3& dir, const Transform& transform) {
+			float margin = GetMargin();
+			Vector3 localDir = transform.GetInvRotMatrix() * dir;
+
+			Vector3 dir_xz = Vector3(localDir.x, 0, localDir.z);
+			Vector3 result = dir_xz.Normalised() * (radius - margin);
+			result.y = (localDir.y > 0) ? halfHeight - margin : -(halfHeight - margin);
+
+			return transform.GetRotMatrix() * result + transform.GetPosition();
+		}
 
 	protected:
 		float radius;
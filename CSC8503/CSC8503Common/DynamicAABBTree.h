@@ -0,0 +1,368 @@
+#pragma once
+#include "../../Common/Vector3.h"
+#include "WorkerPool.h"
+#include <vector>
+#include <functional>
+#include <algorithm>
+
+#define DYNAMIC_TREE_MARGIN 0.5f //how much bigger than the object the fat boxes are on each side
+#define DYNAMIC_TREE_NULL -1
+
+namespace NCL {
+	using namespace NCL::Maths;
+	namespace CSC8503 {
+		/*
+		A bounding volume hierarchy that's kept from one substep to the next, instead of
+		being built again from nothing like the QuadTree. Each object gets a leaf with a
+		'fat' box, a little bigger than the object, and as long as the object stays inside
+		it the tree doesn't change at all. Objects that leave their fat box are taken out
+		and put back in, refitting the boxes above them on the way, and the tree is kept
+		balanced with rotations as it goes, so most substeps only touch a few leaves.
+		It's 3D, so objects stacked on top of each other aren't all lumped together.
+		*/
+		template<class T>
+		class DynamicAABBTree {
+		public:
+			typedef std::function<void(T, T)> DynamicTreePairFunc;
+
+			DynamicAABBTree(float margin = DYNAMIC_TREE_MARGIN) {
+				this->margin	= margin;
+				root			= DYNAMIC_TREE_NULL;
+				freeList		= DYNAMIC_TREE_NULL;
+			}
+			~DynamicAABBTree() {
+			}
+
+			void Clear() {
+				nodes.clear();
+				root		= DYNAMIC_TREE_NULL;
+				freeList	= DYNAMIC_TREE_NULL;
+			}
+
+			//Returns the proxy to Move and Remove the object with later
+			int Insert(T object, const Vector3& pos, const Vector3& halfSizes) {
+				int leaf = AllocateNode();
+				Node& n = nodes[leaf];
+				n.object	= object;
+				n.boundsMin = pos - halfSizes - Vector3(margin, margin, margin);
+				n.boundsMax = pos + halfSizes + Vector3(margin, margin, margin);
+				n.height	= 0;
+				InsertLeaf(leaf);
+				return leaf;
+			}
+
+			void Remove(int proxy) {
+				RemoveLeaf(proxy);
+				FreeNode(proxy);
+			}
+
+			//Returns true if the object had left its fat box, and so was moved in the tree
+			bool Move(int proxy, const Vector3& pos, const Vector3& halfSizes) {
+				Vector3 boundsMin = pos - halfSizes;
+				Vector3 boundsMax = pos + halfSizes;
+				Node& n = nodes[proxy];
+				if (Contains(n.boundsMin, n.boundsMax, boundsMin, boundsMax)) {
+					return false;
+				}
+				RemoveLeaf(proxy);
+				nodes[proxy].boundsMin = boundsMin - Vector3(margin, margin, margin);
+				nodes[proxy].boundsMax = boundsMax + Vector3(margin, margin, margin);
+				InsertLeaf(proxy);
+				return true;
+			}
+
+			T GetObject(int proxy) const {
+				return nodes[proxy].object;
+			}
+
+			int GetHeight() const {
+				return root == DYNAMIC_TREE_NULL ? 0 : nodes[root].height;
+			}
+
+			/*
+			Calls func once for each pair of objects whose fat boxes overlap. Every pair of
+			leaves meets at exactly one node, with one leaf under each of its children, so
+			walking down the children of every node together finds each pair just once.
+			*/
+			void OperateOnPairs(DynamicTreePairFunc func) {
+				FindPairs(0, (int)nodes.size(), pairStack, func);
+			}
+
+			//Adds the same pairs as OperateOnPairs to pairs, with the nodes split up between the pool's threads
+			void FindPairs(WorkerPool& pool, std::vector<std::pair<T, T>>& pairs) {
+				if ((int)jobStacks.size() < pool.GetNumJobs()) {
+					jobStacks.resize(pool.GetNumJobs());
+				}
+				pool.RunRanges((int)nodes.size(), jobPairs, pairs,
+					[&](int job, int first, int last, std::vector<std::pair<T, T>>& out) {
+						FindPairs(first, last, jobStacks[job], [&](T a, T b) { out.push_back(std::make_pair(a, b)); });
+					});
+			}
+
+		protected:
+			struct Node {
+				Vector3 boundsMin;
+				Vector3 boundsMax;
+				T		object;
+				int		parent;	//next free node, for nodes on the free list
+				int		left;	//DYNAMIC_TREE_NULL for a leaf
+				int		right;
+				int		height;	//0 for a leaf, -1 for a free node
+
+				bool IsLeaf() const {
+					return left == DYNAMIC_TREE_NULL;
+				}
+			};
+
+			//Walks down from the nodes first to last, as each pair is only found under one node these can be split up
+			template<class PairFunc>
+			void FindPairs(int first, int last, std::vector<std::pair<int, int>>& stack, const PairFunc& func) const {
+				stack.clear();
+				for (int i = first; i < last; ++i) {
+					if (nodes[i].height > 0) {
+						stack.push_back(std::make_pair(nodes[i].left, nodes[i].right));
+					}
+				}
+				while (!stack.empty()) {
+					std::pair<int, int> p = stack.back();
+					stack.pop_back();
+
+					const Node& a = nodes[p.first];
+					const Node& b = nodes[p.second];
+					if (!Overlaps(a.boundsMin, a.boundsMax, b.boundsMin, b.boundsMax)) {
+						continue;
+					}
+					if (a.IsLeaf() && b.IsLeaf()) {
+						func(a.object, b.object);
+					}
+					else if (b.IsLeaf() || (!a.IsLeaf() && SurfaceArea(a.boundsMin, a.boundsMax) >= SurfaceArea(b.boundsMin, b.boundsMax))) {
+						stack.push_back(std::make_pair(a.left, p.second)); //split the bigger one
+						stack.push_back(std::make_pair(a.right, p.second));
+					}
+					else {
+						stack.push_back(std::make_pair(p.first, b.left));
+						stack.push_back(std::make_pair(p.first, b.right));
+					}
+				}
+			}
+
+			static bool Overlaps(const Vector3& minA, const Vector3& maxA, const Vector3& minB, const Vector3& maxB) {
+				return	minA.x <= maxB.x && maxA.x >= minB.x &&
+						minA.y <= maxB.y && maxA.y >= minB.y &&
+						minA.z <= maxB.z && maxA.z >= minB.z;
+			}
+
+			static bool Contains(const Vector3& outerMin, const Vector3& outerMax, const Vector3& innerMin, const Vector3& innerMax) {
+				return	outerMin.x <= innerMin.x && outerMin.y <= innerMin.y && outerMin.z <= innerMin.z &&
+						outerMax.x >= innerMax.x && outerMax.y >= innerMax.y && outerMax.z >= innerMax.z;
+			}
+
+			static Vector3 MinCorner(const Vector3& a, const Vector3& b) {
+				return Vector3((std::min)(a.x, b.x), (std::min)(a.y, b.y), (std::min)(a.z, b.z));
+			}
+
+			static Vector3 MaxCorner(const Vector3& a, const Vector3& b) {
+				return Vector3((std::max)(a.x, b.x), (std::max)(a.y, b.y), (std::max)(a.z, b.z));
+			}
+
+			static float SurfaceArea(const Vector3& boundsMin, const Vector3& boundsMax) {
+				Vector3 d = boundsMax - boundsMin;
+				return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+			}
+
+			static float CombinedArea(const Node& a, const Node& b) {
+				return SurfaceArea(MinCorner(a.boundsMin, b.boundsMin), MaxCorner(a.boundsMax, b.boundsMax));
+			}
+
+			void Refit(int index) {
+				Node& n			= nodes[index];
+				const Node& l	= nodes[n.left];
+				const Node& r	= nodes[n.right];
+				n.boundsMin = MinCorner(l.boundsMin, r.boundsMin);
+				n.boundsMax = MaxCorner(l.boundsMax, r.boundsMax);
+				n.height	= 1 + (std::max)(l.height, r.height);
+			}
+
+			int AllocateNode() {
+				if (freeList == DYNAMIC_TREE_NULL) {
+					nodes.push_back(Node());
+					freeList = (int)nodes.size() - 1;
+					nodes[freeList].parent = DYNAMIC_TREE_NULL;
+				}
+				int index	= freeList;
+				freeList	= nodes[index].parent;
+
+				Node& n = nodes[index];
+				n.object	= T();
+				n.parent	= DYNAMIC_TREE_NULL;
+				n.left		= DYNAMIC_TREE_NULL;
+				n.right		= DYNAMIC_TREE_NULL;
+				n.height	= 0;
+				return index;
+			}
+
+			void FreeNode(int index) {
+				nodes[index].parent = freeList;
+				nodes[index].height = -1;
+				freeList = index;
+			}
+
+			/*
+			Goes down the tree towards whichever child would grow the least by taking the
+			leaf, and stops where pairing the leaf with the current node is cheaper than
+			going further (a surface area cost, as bigger boxes get hit by more queries).
+			*/
+			void InsertLeaf(int leaf) {
+				if (root == DYNAMIC_TREE_NULL) {
+					root = leaf;
+					nodes[root].parent = DYNAMIC_TREE_NULL;
+					return;
+				}
+				int index = root;
+				while (!nodes[index].IsLeaf()) {
+					const Node& n = nodes[index];
+					float area			= SurfaceArea(n.boundsMin, n.boundsMax);
+					float combinedArea	= CombinedArea(n, nodes[leaf]);
+
+					float cost			= 2.0f * combinedArea;				//new parent for this node and the leaf
+					float inheritance	= 2.0f * (combinedArea - area);	//every node below here grows by this much
+
+					float costLeft	= ChildCost(n.left, leaf) + inheritance;
+					float costRight = ChildCost(n.right, leaf) + inheritance;
+					if (cost < costLeft && cost < costRight) {
+						break;
+					}
+					index = (costLeft < costRight) ? n.left : n.right;
+				}
+				int sibling		= index;
+				int oldParent	= nodes[sibling].parent;
+				int newParent	= AllocateNode(); //can reallocate nodes, so no references are held over this
+
+				nodes[newParent].parent = oldParent;
+				nodes[newParent].left	= sibling;
+				nodes[newParent].right	= leaf;
+				nodes[sibling].parent	= newParent;
+				nodes[leaf].parent		= newParent;
+				if (oldParent == DYNAMIC_TREE_NULL) {
+					root = newParent;
+				}
+				else if (nodes[oldParent].left == sibling) {
+					nodes[oldParent].left = newParent;
+				}
+				else {
+					nodes[oldParent].right = newParent;
+				}
+				RefitUpwards(newParent);
+			}
+
+			float ChildCost(int child, int leaf) const {
+				const Node& c = nodes[child];
+				float combinedArea = CombinedArea(c, nodes[leaf]);
+				if (c.IsLeaf()) {
+					return combinedArea;
+				}
+				return combinedArea - SurfaceArea(c.boundsMin, c.boundsMax);
+			}
+
+			void RemoveLeaf(int leaf) {
+				if (leaf == root) {
+					root = DYNAMIC_TREE_NULL;
+					return;
+				}
+				int parent		= nodes[leaf].parent;
+				int grandParent = nodes[parent].parent;
+				int sibling		= (nodes[parent].left == leaf) ? nodes[parent].right : nodes[parent].left;
+
+				//The sibling takes the parent's place
+				nodes[sibling].parent = grandParent;
+				FreeNode(parent);
+				if (grandParent == DYNAMIC_TREE_NULL) {
+					root = sibling;
+					return;
+				}
+				if (nodes[grandParent].left == parent) {
+					nodes[grandParent].left = sibling;
+				}
+				else {
+					nodes[grandParent].right = sibling;
+				}
+				RefitUpwards(grandParent);
+			}
+
+			void RefitUpwards(int index) {
+				while (index != DYNAMIC_TREE_NULL) {
+					index = Balance(index);
+					Refit(index);
+					index = nodes[index].parent;
+				}
+			}
+
+			/*
+			If one of a's children is more than one level taller than the other, the taller
+			child is rotated up into a's place and a takes the taller of its grandchildren's
+			place, with the shorter grandchild taking a's spot under it. Returns whichever
+			node is now where a was.
+			*/
+			int Balance(int a) {
+				if (nodes[a].IsLeaf() || nodes[a].height < 2) {
+					return a;
+				}
+				int b = nodes[a].left;
+				int c = nodes[a].right;
+				int balance = nodes[c].height - nodes[b].height;
+				if (balance > 1) {
+					return Rotate(a, c, false);
+				}
+				if (balance < -1) {
+					return Rotate(a, b, true);
+				}
+				return a;
+			}
+
+			//up is the child of a being rotated up
+			int Rotate(int a, int up, bool upIsLeft) {
+				int f = nodes[up].left;
+				int g = nodes[up].right;
+
+				//up takes a's place, with a as its left child
+				nodes[up].left		= a;
+				nodes[up].parent	= nodes[a].parent;
+				nodes[a].parent		= up;
+				if (nodes[up].parent == DYNAMIC_TREE_NULL) {
+					root = up;
+				}
+				else if (nodes[nodes[up].parent].left == a) {
+					nodes[nodes[up].parent].left = up;
+				}
+				else {
+					nodes[nodes[up].parent].right = up;
+				}
+
+				//the taller grandchild stays with up, the other goes to a where up used to be
+				int keep	= (nodes[f].height > nodes[g].height) ? f : g;
+				int give	= (keep == f) ? g : f;
+				nodes[up].right		= keep;
+				nodes[give].parent	= a;
+				if (upIsLeft) {
+					nodes[a].left = give;
+				}
+				else {
+					nodes[a].right = give;
+				}
+
+				Refit(a);
+				Refit(up);
+				return up;
+			}
+
+			std::vector<Node>	nodes;
+			int					root;
+			int					freeList;
+			float				margin;
+
+			std::vector<std::pair<int, int>> pairStack; //kept around so pair finding doesn't allocate
+			std::vector<std::vector<std::pair<T, T>>>	jobPairs;	//one per job, for the threaded FindPairs
+			std::vector<std::vector<std::pair<int, int>>>	jobStacks;	//and a pairStack for each job
+		};
+	}
+}
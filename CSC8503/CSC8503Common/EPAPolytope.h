@@ -0,0 +1,273 @@
+#pragma once
+#include "../../Common/Vector3.h"
+#include <cfloat>
+#include <algorithm>
+
+namespace NCL {
+	using namespace NCL::Maths;
+
+	struct Point;
+
+	struct EPAFace {
+		int		v[3];		//Vertex indices, counter clockwise seen from outside
+		int		adj[3];		//Face across edge (v[i], v[(i + 1) % 3])
+		int		adjEdge[3];	//Which edge of that adjacent face is shared with this one
+		Vector3 normal;		//Outward unit normal
+		float	distance;	//Distance of the face plane from the origin
+		bool	obsolete;	//Removed from the polytope, slot waiting to be reused
+		int		serial;		//Bumped every time the slot is reused, to spot stale heap entries
+	};
+
+	/*
+	Polytope used by EPA. Vertices live in a pool and are only ever referenced by index,
+	so removing or adding a face never copies a Point around. Faces keep track of their
+	neighbours, which lets the horizon seen from a new support point be found by walking
+	the visible faces only, instead of comparing every edge of every removed face.
+
+	Face distances are kept in a min-heap. Removed faces are not taken out of it, their
+	entries are just skipped when they reach the top (lazy deletion).
+
+	Everything lives in fixed size arrays, the limits are template parameters so that
+	callers can pick a budget per query.
+	*/
+	template<int MaxVertices, int MaxFaces, int MaxHorizon>
+	class EPAPolytope {
+	public:
+		EPAPolytope() {
+			numVertices = 0;
+			numFaces	= 0;
+			numFree		= 0;
+			heapSize	= 0;
+		}
+
+		//Builds the starting polytope from GJK's final simplex (faces ABC, ACD, ADB, BDC)
+		void Init(const Point& a, const Point& b, const Point& c, const Point& d) {
+			numVertices = 0;
+			numFaces	= 0;
+			numFree		= 0;
+			heapSize	= 0;
+
+			int ia = AddVertex(a);
+			int ib = AddVertex(b);
+			int ic = AddVertex(c);
+			int id = AddVertex(d);
+
+			int abc = AddFace(ia, ib, ic);
+			int acd = AddFace(ia, ic, id);
+			int adb = AddFace(ia, id, ib);
+			int bdc = AddFace(ib, id, ic);
+
+			Link(abc, 0, adb, 2); //AB
+			Link(abc, 1, bdc, 2); //BC
+			Link(abc, 2, acd, 0); //CA
+			Link(acd, 1, bdc, 1); //CD
+			Link(acd, 2, adb, 0); //DA
+			Link(adb, 1, bdc, 0); //DB
+		}
+
+		//Returns the live face closest to the origin
+		int ClosestFace() {
+			while (heapSize > 0) {
+				const HeapEntry& top = heap[0];
+				if (!faces[top.face].obsolete && faces[top.face].serial == top.serial) {
+					return top.face;
+				}
+				std::pop_heap(heap, heap + heapSize, HeapEntry::Further);
+				heapSize--;
+			}
+			return -1;
+		}
+
+		/*
+		Adds p to the polytope: every face visible from p is removed, and the hole is
+		closed with a fan of new faces from p to the horizon edges. visibleFace must be
+		a face that p can see (the face p was found from). Returns false if the polytope
+		has run out of room, in which case it is left untouched.
+		*/
+		bool Expand(const Point& p, int visibleFace) {
+			if (numVertices >= MaxVertices) {
+				return false;
+			}
+			numHorizon = 0;
+			numRemoved = 0;
+
+			//Walk the visible region, collecting the edges on its border
+			const Vector3& point = p.p;
+			Remove(visibleFace);
+			for (int i = 0; i < 3; ++i) {
+				if (!Silhouette(faces[visibleFace].adj[i], faces[visibleFace].adjEdge[i], point)) {
+					Restore();
+					return false;
+				}
+			}
+
+			if (numHorizon < 3 || numFree + (MaxFaces - numFaces) < numHorizon) {
+				Restore();
+				return false;
+			}
+
+			//Each new face runs (start, end, p) along a horizon edge. Work out which face
+			//follows which around the loop before touching anything
+			int start[MaxHorizon];
+			int end[MaxHorizon];
+			int next[MaxHorizon];
+			for (int i = 0; i < numHorizon; ++i) {
+				const EPAFace& across = faces[horizon[i].face];
+				start[i]	= across.v[(horizon[i].edge + 1) % 3];
+				end[i]		= across.v[horizon[i].edge];
+			}
+			for (int i = 0; i < numHorizon; ++i) {
+				next[i] = 0;
+				while (next[i] < numHorizon && start[next[i]] != end[i]) {
+					next[i]++;
+				}
+				if (next[i] == numHorizon) {
+					Restore();
+					return false; //horizon isn't a closed loop, numerical trouble
+				}
+			}
+
+			int ip = AddVertex(p);
+
+			//Fan of new faces, each one sharing its first edge with a face on the horizon
+			int newFaces[MaxHorizon];
+			for (int i = 0; i < numHorizon; ++i) {
+				newFaces[i] = AddFace(start[i], end[i], ip);
+				Link(newFaces[i], 0, horizon[i].face, horizon[i].edge);
+			}
+			//...and its other two edges with its neighbours in the fan
+			for (int i = 0; i < numHorizon; ++i) {
+				Link(newFaces[i], 1, newFaces[next[i]], 2);
+			}
+
+			//Removed faces can be reused from now on
+			for (int i = 0; i < numRemoved; ++i) {
+				freeFaces[numFree++] = removed[i];
+			}
+			return true;
+		}
+
+		const EPAFace& GetFace(int i) const {
+			return faces[i];
+		}
+
+		const Point& GetVertex(int i) const {
+			return vertices[i];
+		}
+
+	protected:
+		struct HorizonEdge {
+			int face;
+			int edge;
+		};
+
+		struct HeapEntry {
+			float	distance;
+			int		face;
+			int		serial;
+
+			static bool Further(const HeapEntry& a, const HeapEntry& b) {
+				return a.distance > b.distance;
+			}
+		};
+
+		int AddVertex(const Point& p) {
+			vertices[numVertices] = p;
+			return numVertices++;
+		}
+
+		int AddFace(int a, int b, int c) {
+			int index;
+			if (numFree > 0) {
+				index = freeFaces[--numFree];
+			}
+			else {
+				index = numFaces++;
+				faces[index].serial = 0;
+			}
+			EPAFace& f = faces[index];
+			f.v[0] = a;
+			f.v[1] = b;
+			f.v[2] = c;
+			f.obsolete = false;
+			f.serial++;
+
+			const Vector3& pa = vertices[a].p;
+			f.normal	= Vector3::Cross(vertices[b].p - pa, vertices[c].p - pa).Normalised();
+			f.distance	= Vector3::Dot(f.normal, pa);
+
+			PushHeap(index);
+			return index;
+		}
+
+		void PushHeap(int face) {
+			if (heapSize == MaxFaces * 2) {
+				//Mostly stale entries by now, rebuild from the live faces only
+				heapSize = 0;
+				for (int i = 0; i < numFaces; ++i) {
+					if (!faces[i].obsolete && i != face) {
+						heap[heapSize++] = { faces[i].distance, i, faces[i].serial };
+					}
+				}
+				std::make_heap(heap, heap + heapSize, HeapEntry::Further);
+			}
+			heap[heapSize++] = { faces[face].distance, face, faces[face].serial };
+			std::push_heap(heap, heap + heapSize, HeapEntry::Further);
+		}
+
+		void Link(int faceA, int edgeA, int faceB, int edgeB) {
+			faces[faceA].adj[edgeA]		= faceB;
+			faces[faceA].adjEdge[edgeA] = edgeB;
+			faces[faceB].adj[edgeB]		= faceA;
+			faces[faceB].adjEdge[edgeB] = edgeA;
+		}
+
+		void Remove(int face) {
+			faces[face].obsolete = true;
+			removed[numRemoved++] = face;
+		}
+
+		//Undoes the removals of a failed Expand
+		void Restore() {
+			for (int i = 0; i < numRemoved; ++i) {
+				faces[removed[i]].obsolete = false;
+			}
+		}
+
+		//Depth first walk over faces visible from point, entering face through edge
+		bool Silhouette(int face, int edge, const Vector3& point) {
+			EPAFace& f = faces[face];
+			if (f.obsolete) {
+				return true;
+			}
+			if (Vector3::Dot(f.normal, point - vertices[f.v[0]].p) <= 0) {
+				if (numHorizon >= MaxHorizon) {
+					return false;
+				}
+				horizon[numHorizon].face = face;
+				horizon[numHorizon].edge = edge;
+				numHorizon++;
+				return true;
+			}
+			Remove(face);
+			int next = (edge + 1) % 3;
+			int last = (edge + 2) % 3;
+			return	Silhouette(f.adj[next], f.adjEdge[next], point) &&
+					Silhouette(f.adj[last], f.adjEdge[last], point);
+		}
+
+		Point		vertices[MaxVertices];
+		EPAFace		faces[MaxFaces];
+		int			freeFaces[MaxFaces];
+		int			removed[MaxFaces];
+		HorizonEdge horizon[MaxHorizon];
+		HeapEntry	heap[MaxFaces * 2];
+
+		int numVertices;
+		int numFaces;	//high water mark of used face slots
+		int numFree;
+		int numRemoved;
+		int numHorizon;
+		int heapSize;
+	};
+}
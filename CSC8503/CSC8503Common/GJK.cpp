@@ -2,35 +2,235 @@
 
 #include "../../Common/Plane.h"
 #include "../../Common/Maths.h"
+#include "EPAPolytope.h"
+#include "GJKSimd.h"
+#include "GJKSupport.h"
 
-#define GJK_MAX_NUM_ITERATIONS 64
+#ifdef _DEBUG
+#include <cstring>
+#include <iostream>
+#endif
 
+using namespace NCL;
 
-bool NCL::GJKCalculation(GameObject* coll1, GameObject* coll2, CollisionDetection::CollisionInfo& collisionInfo)
+
+
+static bool IsRounded(VolumeType type)
 {
-	collisionInfo.a = coll1;
-	collisionInfo.b = coll2;
+	return	type == VolumeType::Sphere ||
+			type == VolumeType::Capsule ||
+			type == VolumeType::Cylinder;
+}
 
-	Vector3* mtv;
+/*
+The GJK and EPA code below is written against a pair of shapes rather than a pair of
+GameObjects, so the same code serves both the single pair queries and the batched ones.
+ObjectPair goes through the GameObject's volume and transform, VolumePair does the same
+for volumes that aren't a GameObject's own (the children of a compound), and ShapePair
+reads the plain GJKShape copies made up front for a batch.
+*/
+struct ObjectPair {
+	GameObject* coll1;
+	GameObject* coll2;
 
-	Vector3 coll1Pos = coll1->GetTransform().GetPosition();
-	Vector3 coll2Pos = coll2->GetTransform().GetPosition();
+	Vector3 SupportA(const Vector3& dir) const { return coll1->GetBoundingVolume()->Support(dir, coll1->GetTransform()); }
+	Vector3 SupportB(const Vector3& dir) const { return coll2->GetBoundingVolume()->Support(dir, coll2->GetTransform()); }
 
+	Vector3 PositionA() const { return coll1->GetTransform().GetPosition(); }
+	Vector3 PositionB() const { return coll2->GetTransform().GetPosition(); }
 
-	Point a, b, c, d; //Simplex: just a set of points (a is always most recently added)
-	Vector3 search_dir = coll1Pos - coll2Pos; //initial search direction between colliders
+	Matrix3 RotationA() const		{ return coll1->GetTransform().GetRotMatrix(); }
+	Matrix3 RotationB() const		{ return coll2->GetTransform().GetRotMatrix(); }
+	Matrix3 InvRotationA() const	{ return coll1->GetTransform().GetInvRotMatrix(); }
+	Matrix3 InvRotationB() const	{ return coll2->GetTransform().GetInvRotMatrix(); }
+
+	bool Rounded() const { return IsRounded(coll1->GetBoundingVolume()->type) || IsRounded(coll2->GetBoundingVolume()->type); }
+
+	Vector3 CoreSupportA(const Vector3& dir) const { return coll1->GetBoundingVolume()->CoreSupport(dir, coll1->GetTransform()); }
+	Vector3 CoreSupportB(const Vector3& dir) const { return coll2->GetBoundingVolume()->CoreSupport(dir, coll2->GetTransform()); }
+
+	float MarginA() const { return coll1->GetBoundingVolume()->GetMargin(); }
+	float MarginB() const { return coll2->GetBoundingVolume()->GetMargin(); }
+};
+
+struct VolumePair {
+	CollisionVolume*	volA;
+	const Transform*	transformA;
+	CollisionVolume*	volB;
+	const Transform*	transformB;
+
+	Vector3 SupportA(const Vector3& dir) const { return volA->Support(dir, *transformA); }
+	Vector3 SupportB(const Vector3& dir) const { return volB->Support(dir, *transformB); }
+
+	Vector3 PositionA() const { return transformA->GetPosition(); }
+	Vector3 PositionB() const { return transformB->GetPosition(); }
+
+	Matrix3 RotationA() const		{ return transformA->GetRotMatrix(); }
+	Matrix3 RotationB() const		{ return transformB->GetRotMatrix(); }
+	Matrix3 InvRotationA() const	{ return transformA->GetInvRotMatrix(); }
+	Matrix3 InvRotationB() const	{ return transformB->GetInvRotMatrix(); }
+
+	bool Rounded() const { return IsRounded(volA->type) || IsRounded(volB->type); }
+
+	Vector3 CoreSupportA(const Vector3& dir) const { return volA->CoreSupport(dir, *transformA); }
+	Vector3 CoreSupportB(const Vector3& dir) const { return volB->CoreSupport(dir, *transformB); }
+
+	float MarginA() const { return volA->GetMargin(); }
+	float MarginB() const { return volB->GetMargin(); }
+};
+
+struct ShapePair {
+	const GJKShape* shapeA;
+	const GJKShape* shapeB;
+
+	Vector3 SupportA(const Vector3& dir) const { return shapeA->Support(dir); }
+	Vector3 SupportB(const Vector3& dir) const { return shapeB->Support(dir); }
+
+	Vector3 PositionA() const { return shapeA->position; }
+	Vector3 PositionB() const { return shapeB->position; }
+
+	const Matrix3& RotationA() const	{ return shapeA->rotation; }
+	const Matrix3& RotationB() const	{ return shapeB->rotation; }
+	const Matrix3& InvRotationA() const { return shapeA->invRotation; }
+	const Matrix3& InvRotationB() const { return shapeB->invRotation; }
+
+	bool Rounded() const { return IsRounded(shapeA->type) || IsRounded(shapeB->type); }
+
+	Vector3 CoreSupportA(const Vector3& dir) const { return shapeA->CoreSupport(dir); }
+	Vector3 CoreSupportB(const Vector3& dir) const { return shapeB->CoreSupport(dir); }
+
+	float MarginA() const { return shapeA->margin; }
+	float MarginB() const { return shapeB->margin; }
+};
+
+//The cores of a pair, for margin mode. Only the support functions are needed.
+template<class PairType>
+struct CorePair {
+	const PairType& pair;
+
+	Vector3 SupportA(const Vector3& dir) const { return pair.CoreSupportA(dir); }
+	Vector3 SupportB(const Vector3& dir) const { return pair.CoreSupportB(dir); }
+};
+
+static bool gjkMarginMode = true;
+
+void NCL::SetGJKMarginMode(bool enabled)
+{
+	gjkMarginMode = enabled;
+}
+
+bool NCL::GetGJKMarginMode()
+{
+	return gjkMarginMode;
+}
+
+template<class PairType>
+static void SearchPoint(Point& point, const Vector3& search_dir, const PairType& pair)
+{
+	point.b = pair.SupportB(search_dir);
+	point.a = pair.SupportA(-search_dir);
+	point.p = point.b - point.a;
+}
+
+template<class PairType>
+static bool SeparatingAxisTest(const Vector3& axis, const PairType& pair)
+{
+	Point p;
+	SearchPoint(p, axis, pair);
+	return Vector3::Dot(p.p, axis) < 0; //the Minkowski difference lies entirely behind the origin along axis
+}
+
+template<class PairType>
+static void StoreSimplexLocal(GJKCache& cache, const Point& a, const Point& b, const Point& c, const Point& d, const PairType& pair)
+{
+	Matrix3 invRotA = pair.InvRotationA();
+	Matrix3 invRotB = pair.InvRotationB();
+
+	const Point* points[4] = { &a, &b, &c, &d };
+	for (int i = 0; i < 4; ++i) {
+		cache.localA[i] = invRotA * (points[i]->a - pair.PositionA());
+		cache.localB[i] = invRotB * (points[i]->b - pair.PositionB());
+	}
+	cache.simplexSize = 4;
+}
+
+template<class PairType>
+static bool RestoreSimplexLocal(const GJKCache& cache, Point& a, Point& b, Point& c, Point& d, const PairType& pair)
+{
+	Matrix3 rotA = pair.RotationA();
+	Matrix3 rotB = pair.RotationB();
+
+	Point* points[4] = { &a, &b, &c, &d };
+	for (int i = 0; i < 4; ++i) {
+		//Still points of both shapes, so the tetrahedron stays inside the Minkowski difference
+		points[i]->a = rotA * cache.localA[i] + pair.PositionA();
+		points[i]->b = rotB * cache.localB[i] + pair.PositionB();
+		points[i]->p = points[i]->b - points[i]->a;
+	}
+
+	//Keep the winding EPA expects: ABC faces away from D
+	float volume = Vector3::Dot(Vector3::Cross(b.p - a.p, c.p - a.p), d.p - a.p);
+	if (abs(volume) < 0.000001f) {
+		return false; //degenerate, can't enclose anything
+	}
+	if (volume > 0) {
+		Point temp = b;
+		b = c;
+		c = temp;
+	}
+
+	Vector3 AO = -a.p;
+	if (Vector3::Dot(Vector3::Cross(b.p - a.p, c.p - a.p), AO) > 0 ||
+		Vector3::Dot(Vector3::Cross(c.p - a.p, d.p - a.p), AO) > 0 ||
+		Vector3::Dot(Vector3::Cross(d.p - a.p, b.p - a.p), AO) > 0 ||
+		Vector3::Dot(Vector3::Cross(d.p - b.p, c.p - b.p), -b.p) > 0) {
+		return false; //origin has moved outside one of the faces
+	}
+	return true;
+}
+
+//Cache checks ahead of a search. Returns GJK_SEPARATED or GJK_ENCLOSED if the cache settles the query,
+//otherwise GJK_UNDECIDED with the direction the search should start from.
+template<class PairType>
+static int GJKWarmStart(const PairType& pair, Point& a, Point& b, Point& c, Point& d, GJKCache* cache, Vector3& search_dir)
+{
+	//Early out for near misses: the axis that separated the pair last query usually still does
+	if (cache && cache->separated) {
+		if (SeparatingAxisTest(cache->separatingAxis, pair)) {
+			return GJK_SEPARATED;
+		}
+		cache->separated = false;
+	}
 
+	//Warm start: if last query's tetrahedron still encloses the origin, go straight to EPA
+	if (cache && cache->simplexSize == 4 && RestoreSimplexLocal(*cache, a, b, c, d, pair)) {
+		return GJK_ENCLOSED;
+	}
+
+	search_dir = pair.PositionA() - pair.PositionB(); //initial search direction between colliders
+	if (cache && cache->lastSearchDir != Vector3(0, 0, 0)) {
+		search_dir = cache->lastSearchDir; //last query's direction is a much better guess for coherent pairs
+	}
+	if (cache) {
+		cache->simplexSize = 0;
+	}
+	return GJK_UNDECIDED;
+}
+
+//The GJK search itself. GJK_ENCLOSED leaves the tetrahedron enclosing the origin in a, b, c, d,
+//GJK_SEPARATED leaves a separating axis in search_dir.
+template<class PairType>
+static int GJKSearch(const PairType& pair, Point& a, Point& b, Point& c, Point& d, Vector3& search_dir)
+{
 	 //Get initial point for simplex
-	//Point c;
-	CalculateSearchPoint(c, search_dir, coll1, coll2);
+	SearchPoint(c, search_dir, pair);
 	search_dir = -c.p; //search in direction of origin
 
 	//Get second point for a line segment simplex
-	//Point b;
-	CalculateSearchPoint(b, search_dir, coll1, coll2);
+	SearchPoint(b, search_dir, pair);
 
 	if (Vector3::Dot(b.p, search_dir) < 0) {
-		return false;
+		return GJK_SEPARATED;
 	}//we didn't reach the origin, won't enclose it
 
 	search_dir = Vector3::Cross(Vector3::Cross(c.p - b.p, -b.p), c.p - b.p); //search perpendicular to line segment towards origin
@@ -44,11 +244,10 @@ bool NCL::GJKCalculation(GameObject* coll1, GameObject* coll2, CollisionDetectio
 
 	for (int iterations = 0; iterations < GJK_MAX_NUM_ITERATIONS; iterations++)
 	{
-		//Point a;
-		CalculateSearchPoint(a, search_dir, coll1, coll2);
+		SearchPoint(a, search_dir, pair);
 
 		if (Vector3::Dot(a.p, search_dir) < 0) {
-			return false;
+			return GJK_SEPARATED;
 		}//we didn't reach the origin, won't enclose it
 
 		simp_dim++;
@@ -56,12 +255,282 @@ bool NCL::GJKCalculation(GameObject* coll1, GameObject* coll2, CollisionDetectio
 			update_simplex3(a, b, c, d, simp_dim, search_dir);
 		}
 		else if (update_simplex4(a, b, c, d, simp_dim, search_dir)) {
-			EPA(a, b, c, d, coll1, coll2, collisionInfo);
-			return true;
+			return GJK_ENCLOSED;
 		}
 	}//endfor
 
-	return false;
+	return GJK_UNDECIDED;
+}
+
+//Keeps what a search found for the next query on this pair
+template<class PairType>
+static void GJKRecord(int status, const PairType& pair, const Point& a, const Point& b, const Point& c, const Point& d, const Vector3& search_dir, GJKCache* cache)
+{
+	if (!cache) {
+		return;
+	}
+	if (status == GJK_SEPARATED) {
+		RecordSeparatingAxis(*cache, search_dir);
+	}
+	else if (status == GJK_ENCLOSED) {
+		StoreSimplexLocal(*cache, a, b, c, d, pair);
+		cache->lastSearchDir = search_dir;
+	}
+}
+
+//Boolean GJK. Returns true with the tetrahedron enclosing the origin in a, b, c, d, ready for EPA.
+template<class PairType>
+static bool GJKIntersection(const PairType& pair, Point& a, Point& b, Point& c, Point& d, GJKCache* cache)
+{
+	Vector3 search_dir;
+	int status = GJKWarmStart(pair, a, b, c, d, cache, search_dir);
+	if (status != GJK_UNDECIDED) {
+		return status == GJK_ENCLOSED;
+	}
+	status = GJKSearch(pair, a, b, c, d, search_dir);
+	GJKRecord(status, pair, a, b, c, d, search_dir, cache);
+	return status == GJK_ENCLOSED;
+}
+
+#define GJK_DISTANCE_TOLERANCE 0.0001f
+
+//GJK distance mode. Fills in result, and returns v, the point of the Minkowski difference closest to the origin
+template<class PairType>
+static Vector3 GJKClosestPoints(const PairType& pair, const Vector3& search_dir, GJKDistanceResult& result)
+{
+	Point	simplex[4];
+	float	weights[4];
+	int		simp_dim = 0;
+
+	//v is the point of the current simplex closest to the origin
+	SearchPoint(simplex[0], search_dir, pair);
+	weights[0] = 1.0f;
+	simp_dim = 1;
+	Vector3 v = simplex[0].p;
+
+	result.overlapping = false;
+
+	for (int iterations = 0; iterations < GJK_MAX_NUM_ITERATIONS; iterations++) {
+		float vLengthSq = v.LengthSquared();
+		if (vLengthSq < GJK_DISTANCE_TOLERANCE * GJK_DISTANCE_TOLERANCE) {
+			result.overlapping = true; //origin is (as good as) on the simplex
+			break;
+		}
+
+		Point w;
+		SearchPoint(w, -v, pair);
+
+		//No support point gets noticeably closer to the origin than v, so v is the closest point
+		if (vLengthSq - Vector3::Dot(v, w.p) <= GJK_DISTANCE_TOLERANCE * sqrt(vLengthSq)) {
+			break;
+		}
+
+		bool duplicate = false;
+		for (int i = 0; i < simp_dim; ++i) {
+			duplicate |= (simplex[i].p == w.p);
+		}
+		if (duplicate) {
+			break; //cycling on the same vertex, can't get any closer
+		}
+
+		simplex[simp_dim++] = w;
+		if (!closest_on_simplex(simplex, weights, simp_dim, v)) {
+			result.overlapping = true;
+			break;
+		}
+	}
+
+	//Closest points have the same barycentric coordinates as v, in each object's support points
+	result.closestA = Vector3();
+	result.closestB = Vector3();
+	for (int i = 0; i < simp_dim; ++i) {
+		result.closestA += simplex[i].a * weights[i];
+		result.closestB += simplex[i].b * weights[i];
+	}
+	result.distance = result.overlapping ? 0.0f : v.Length();
+
+	return v;
+}
+
+/*
+Margin mode. The cores of rounded shapes are points, lines or a slightly shrunk cylinder,
+which the distance mode settles in a handful of iterations, where the full curved surfaces
+can keep EPA going until it hits its iteration limit. While the cores are apart, the shapes
+touch only if the gap is less than the two margins, and the contact comes straight from the
+closest points. Returns false if the cores overlap, and the full GJK + EPA is needed.
+The separating axis is tested against the full shapes, which hold the rounded ones, so
+it can be shared with the full GJK.
+*/
+template<class PairType>
+static bool MarginContact(const PairType& pair, GJKCache* cache, bool& colliding, CollisionDetection::ContactPoint& contact)
+{
+	float marginA = pair.MarginA();
+	float marginB = pair.MarginB();
+
+	if (cache && cache->separated) {
+		if (SeparatingAxisTest(cache->separatingAxis, pair)) {
+			colliding = false;
+			return true;
+		}
+		cache->separated = false;
+	}
+
+	Vector3 search_dir = pair.PositionA() - pair.PositionB();
+	if (cache && cache->lastSearchDir != Vector3(0, 0, 0)) {
+		search_dir = cache->lastSearchDir;
+	}
+
+	GJKDistanceResult result;
+	Vector3 v = GJKClosestPoints(CorePair<PairType>{ pair }, search_dir, result);
+	if (result.overlapping) {
+		return false;
+	}
+
+	colliding = result.distance < marginA + marginB;
+	if (cache) {
+		if (colliding) {
+			cache->lastSearchDir = -v;
+		}
+		else {
+			RecordSeparatingAxis(*cache, -v); //the cores are far enough apart that the rounded shapes are too
+		}
+	}
+	if (colliding) {
+		Vector3 normal = v / result.distance; //from A to B, the same way round as EPA's
+		contact.localA		= (result.closestA + normal * marginA) - pair.PositionA();
+		contact.localB		= (result.closestB - normal * marginB) - pair.PositionB();
+		contact.normal		= normal;
+		contact.penetration = (marginA + marginB) - result.distance;
+	}
+	return true;
+}
+
+static bool UseMarginMode(float marginA, float marginB)
+{
+	return gjkMarginMode && marginA + marginB > 0.0f;
+}
+
+template<class PairType>
+static void EPAContact(Point& a, Point& b, Point& c, Point& d, const PairType& pair, CollisionDetection::ContactPoint& contact);
+
+//Whole query on one pair: margin mode if it applies, otherwise boolean GJK followed by EPA
+template<class PairType>
+static bool PairContact(const PairType& pair, GJKCache* cache, CollisionDetection::ContactPoint& contact)
+{
+	bool colliding;
+	if (UseMarginMode(pair.MarginA(), pair.MarginB()) && MarginContact(pair, cache, colliding, contact)) {
+		return colliding;
+	}
+
+	Point a, b, c, d; //Simplex: just a set of points (a is always most recently added)
+	if (!GJKIntersection(pair, a, b, c, d, cache)) {
+		return false;
+	}
+	EPAContact(a, b, c, d, pair, contact);
+	return true;
+}
+
+//Queries handed to DispatchTypedPair, which calls Run with the TypedPair for the two shapes
+struct ContactQuery {
+	GJKCache*						 cache;
+	bool							 colliding;
+	CollisionDetection::ContactPoint contact;
+
+	ContactQuery(GJKCache* cache) : cache(cache), colliding(false) {}
+
+	template<class PairType>
+	void Run(const PairType& pair) {
+		colliding = PairContact(pair, cache, contact);
+	}
+};
+
+//Finishes a pair whose search has already been done, by the warm start or the 4 wide kernel
+struct FinishQuery {
+	int				status;
+	Point*			simplex;
+	const Vector3*	searchDir;	//null if the search was skipped, so there's nothing new to cache
+	GJKCache*		cache;
+	GJKBatchResult* result;
+
+	template<class PairType>
+	void Run(const PairType& pair) {
+		if (searchDir) {
+			GJKRecord(status, pair, simplex[0], simplex[1], simplex[2], simplex[3], *searchDir, cache);
+		}
+		result->colliding = (status == GJK_ENCLOSED);
+		if (result->colliding) {
+			EPAContact(simplex[0], simplex[1], simplex[2], simplex[3], pair, result->contact);
+		}
+	}
+};
+
+bool NCL::GJKCalculation(GameObject* coll1, GameObject* coll2, CollisionDetection::CollisionInfo& collisionInfo, GJKCache* cache)
+{
+	collisionInfo.a = coll1;
+	collisionInfo.b = coll2;
+	collisionInfo.ClearContactPoints();
+
+	//Shapes with a typed support mapping get the specialised GJK, anything else goes through the volumes
+	GJKShape shapeA, shapeB;
+	ContactQuery query(cache);
+	if (!ExtractGJKShape(coll1, shapeA) || !ExtractGJKShape(coll2, shapeB) || !DispatchTypedPair(shapeA, shapeB, query)) {
+		query.colliding = PairContact(ObjectPair{ coll1, coll2 }, cache, query.contact);
+	}
+	if (query.colliding) {
+		const CollisionDetection::ContactPoint& contact = query.contact;
+		collisionInfo.AddContactPoint(contact.localA, contact.localB, contact.normal, contact.penetration);
+	}
+	return query.colliding;
+}
+
+bool NCL::GJKContact(CollisionVolume* volA, const Transform& transformA, CollisionVolume* volB, const Transform& transformB, CollisionDetection::ContactPoint& contact)
+{
+	GJKShape shapeA, shapeB;
+	ContactQuery query(nullptr);
+	if (!ExtractGJKShape(volA, transformA, shapeA) || !ExtractGJKShape(volB, transformB, shapeB) || !DispatchTypedPair(shapeA, shapeB, query)) {
+		query.colliding = PairContact(VolumePair{ volA, &transformA, volB, &transformB }, nullptr, query.contact);
+	}
+	if (query.colliding) {
+		contact = query.contact;
+	}
+	return query.colliding;
+}
+
+bool NCL::IsSeparatingAxis(const Vector3& axis, GameObject* coll1, GameObject* coll2)
+{
+	return SeparatingAxisTest(axis, ObjectPair{ coll1, coll2 });
+}
+
+void NCL::RecordSeparatingAxis(GJKCache& cache, const Vector3& axis)
+{
+	cache.separatingAxis	= axis;
+	cache.lastSearchDir		= axis;
+	cache.separated			= true;
+}
+
+void NCL::StoreSimplex(GJKCache& cache, const Point& a, const Point& b, const Point& c, const Point& d, GameObject* coll1, GameObject* coll2)
+{
+	StoreSimplexLocal(cache, a, b, c, d, ObjectPair{ coll1, coll2 });
+}
+
+bool NCL::RestoreSimplex(const GJKCache& cache, Point& a, Point& b, Point& c, Point& d, GameObject* coll1, GameObject* coll2)
+{
+	return RestoreSimplexLocal(cache, a, b, c, d, ObjectPair{ coll1, coll2 });
+}
+
+bool NCL::GJKDistance(GameObject* coll1, GameObject* coll2, GJKDistanceResult& result, GJKCache* cache)
+{
+	Vector3 search_dir = coll1->GetTransform().GetPosition() - coll2->GetTransform().GetPosition();
+	if (cache && cache->lastSearchDir != Vector3(0, 0, 0)) {
+		search_dir = cache->lastSearchDir;
+	}
+
+	Vector3 v = GJKClosestPoints(ObjectPair{ coll1, coll2 }, search_dir, result);
+
+	if (cache && !result.overlapping) {
+		RecordSeparatingAxis(*cache, -v); //the Minkowski difference lies behind the origin along -v
+	}
+	return !result.overlapping;
 }
 
 void NCL::update_simplex3(Point& a, Point& b, Point& c, Point& d, int& simp_dim, Vector3& search_dir)
@@ -156,172 +625,589 @@ bool NCL::update_simplex4(Point& a, Point& b, Point& c, Point& d, int& simp_dim,
 	return true;
 }
 
+//Closest point of triangle abc to the origin, with its barycentric coordinates (Ericson, Real-Time Collision Detection 5.1.5)
+static Vector3 ClosestPtOriginTriangle(const Vector3& a, const Vector3& b, const Vector3& c, float& u, float& v, float& w)
+{
+	Vector3 ab = b - a;
+	Vector3 ac = c - a;
+
+	float d1 = Vector3::Dot(ab, -a);
+	float d2 = Vector3::Dot(ac, -a);
+	if (d1 <= 0.0f && d2 <= 0.0f) { //vertex region A
+		u = 1.0f; v = 0.0f; w = 0.0f;
+		return a;
+	}
+
+	float d3 = Vector3::Dot(ab, -b);
+	float d4 = Vector3::Dot(ac, -b);
+	if (d3 >= 0.0f && d4 <= d3) { //vertex region B
+		u = 0.0f; v = 1.0f; w = 0.0f;
+		return b;
+	}
+
+	float vc = d1 * d4 - d3 * d2;
+	if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) { //edge region AB
+		v = d1 / (d1 - d3);
+		u = 1.0f - v; w = 0.0f;
+		return a + ab * v;
+	}
+
+	float d5 = Vector3::Dot(ab, -c);
+	float d6 = Vector3::Dot(ac, -c);
+	if (d6 >= 0.0f && d5 <= d6) { //vertex region C
+		u = 0.0f; v = 0.0f; w = 1.0f;
+		return c;
+	}
+
+	float vb = d5 * d2 - d1 * d6;
+	if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) { //edge region AC
+		w = d2 / (d2 - d6);
+		u = 1.0f - w; v = 0.0f;
+		return a + ac * w;
+	}
+
+	float va = d3 * d6 - d5 * d4;
+	if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) { //edge region BC
+		w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+		u = 0.0f; v = 1.0f - w;
+		return b + (c - b) * w;
+	}
+
+	//inside face region
+	float denom = 1.0f / (va + vb + vc);
+	v = vb * denom;
+	w = vc * denom;
+	u = 1.0f - v - w;
+	return a + ab * v + ac * w;
+}
+
+//Drops the points with no weight, keeping the simplex as small as the closest feature
+static void ReduceSimplex(Point* simplex, float* weights, int& simp_dim)
+{
+	int kept = 0;
+	for (int i = 0; i < simp_dim; ++i) {
+		if (weights[i] > 0.0f) {
+			simplex[kept] = simplex[i];
+			weights[kept] = weights[i];
+			kept++;
+		}
+	}
+	simp_dim = kept;
+}
+
+bool NCL::closest_on_simplex(Point* simplex, float* weights, int& simp_dim, Vector3& closest)
+{
+	if (simp_dim == 2) {
+		Vector3 ab = simplex[1].p - simplex[0].p;
+		float t = Clamp(Vector3::Dot(-simplex[0].p, ab) / Vector3::Dot(ab, ab), 0.0f, 1.0f);
+		weights[0] = 1.0f - t;
+		weights[1] = t;
+		closest = simplex[0].p + ab * t;
+	}
+	else if (simp_dim == 3) {
+		closest = ClosestPtOriginTriangle(simplex[0].p, simplex[1].p, simplex[2].p, weights[0], weights[1], weights[2]);
+	}
+	else if (simp_dim == 4) {
+		//Test each face the origin is in front of (on the side away from the fourth point)
+		static const int faceIndices[4][4] = { {0, 1, 2, 3}, {0, 2, 3, 1}, {0, 3, 1, 2}, {1, 3, 2, 0} };
+		float bestDistSq = FLT_MAX;
+		float bestWeights[4];
+		bool outside = false;
+
+		for (int f = 0; f < 4; ++f) {
+			const Vector3& a = simplex[faceIndices[f][0]].p;
+			const Vector3& b = simplex[faceIndices[f][1]].p;
+			const Vector3& c = simplex[faceIndices[f][2]].p;
+			const Vector3& d = simplex[faceIndices[f][3]].p;
+
+			Vector3 n = Vector3::Cross(b - a, c - a);
+			if (Vector3::Dot(n, -a) * Vector3::Dot(n, d - a) >= 0.0f) {
+				continue; //origin is on the same side as d
+			}
+			outside = true;
+
+			float faceWeights[3];
+			Vector3 point = ClosestPtOriginTriangle(a, b, c, faceWeights[0], faceWeights[1], faceWeights[2]);
+			float distSq = point.LengthSquared();
+			if (distSq < bestDistSq) {
+				bestDistSq = distSq;
+				closest = point;
+				for (int i = 0; i < 4; ++i) {
+					bestWeights[i] = 0.0f;
+				}
+				for (int i = 0; i < 3; ++i) {
+					bestWeights[faceIndices[f][i]] = faceWeights[i];
+				}
+			}
+		}
+		if (!outside) {
+			return false; //origin enclosed
+		}
+		for (int i = 0; i < 4; ++i) {
+			weights[i] = bestWeights[i];
+		}
+	}
+	ReduceSimplex(simplex, weights, simp_dim);
+	return true;
+}
+
 //Expanding Polytope Algorithm
 #define EPA_TOLERANCE 0.0001
+
+//Polytope limits, can be overridden from the project settings
+#ifndef EPA_MAX_NUM_FACES
 #define EPA_MAX_NUM_FACES 64
+#endif
+#ifndef EPA_MAX_NUM_LOOSE_EDGES
 #define EPA_MAX_NUM_LOOSE_EDGES 32
+#endif
+#ifndef EPA_MAX_NUM_ITERATIONS
 #define EPA_MAX_NUM_ITERATIONS 64
-void NCL::EPA(Point& a, Point& b, Point& c, Point& d, GameObject* coll1, GameObject* coll2, CollisionDetection::CollisionInfo& collisionInfo)
+#endif
+#define EPA_MAX_NUM_VERTICES (EPA_MAX_NUM_ITERATIONS + 4)
+
+//Rounded shapes need a much finer polytope before the closest face stops moving
+#ifndef EPA_MAX_NUM_FACES_ROUNDED
+#define EPA_MAX_NUM_FACES_ROUNDED 256
+#endif
+#ifndef EPA_MAX_NUM_ITERATIONS_ROUNDED
+#define EPA_MAX_NUM_ITERATIONS_ROUNDED 128
+#endif
+#define EPA_MAX_NUM_VERTICES_ROUNDED (EPA_MAX_NUM_ITERATIONS_ROUNDED + 4)
+
+typedef EPAPolytope<EPA_MAX_NUM_VERTICES, EPA_MAX_NUM_FACES, EPA_MAX_NUM_LOOSE_EDGES> Polytope;
+typedef EPAPolytope<EPA_MAX_NUM_VERTICES_ROUNDED, EPA_MAX_NUM_FACES_ROUNDED, EPA_MAX_NUM_LOOSE_EDGES> RoundedPolytope;
+
+//Turns the polytope face closest to the origin into a contact point
+template<class PolytopeType, class PairType>
+static void AddFaceContact(const PolytopeType& polytope, int closest_face, const PairType& pair, CollisionDetection::ContactPoint& contact)
 {
-	Point faces[EPA_MAX_NUM_FACES][4]; //Array of faces, each with 3 verts and a normal
-
-	Vector3 VertexA[3];
-	Vector3 VertexB[3];
-
-	//Init with final simplex from GJK
-	faces[0][0] = a;
-	faces[0][1] = b;
-	faces[0][2] = c;
-	faces[0][3].p = (Vector3::Cross(b.p - a.p, c.p - a.p)).Normalised(); //ABC
-	faces[1][0] = a;
-	faces[1][1] = c;
-	faces[1][2] = d;
-	faces[1][3].p = (Vector3::Cross(c.p - a.p, d.p - a.p)).Normalised(); //ACD
-	faces[2][0] = a;
-	faces[2][1] = d;
-	faces[2][2] = b;
-	faces[2][3].p = (Vector3::Cross(d.p - a.p, b.p - a.p)).Normalised(); //ADB
-	faces[3][0] = b;
-	faces[3][1] = d;
-	faces[3][2] = c;
-	faces[3][3].p = (Vector3::Cross(d.p - b.p, c.p - b.p)).Normalised(); //BDC
-
-	int num_faces = 4;
-	int closest_face;
-
-	for (int iterations = 0; iterations < EPA_MAX_NUM_ITERATIONS; iterations++) {
-		//Find face that's closest to origin
-		float min_dist = Vector3::Dot(faces[0][0].p, faces[0][3].p);
-		closest_face = 0;
-		for (int i = 1; i < num_faces; i++) {
-			float dist = Vector3::Dot(faces[i][0].p, faces[i][3].p);
-			if (dist < min_dist) {
-				min_dist = dist;
-				closest_face = i;
-			}
-		}
+	const EPAFace& face = polytope.GetFace(closest_face);
+	const Point& a = polytope.GetVertex(face.v[0]);
+	const Point& b = polytope.GetVertex(face.v[1]);
+	const Point& c = polytope.GetVertex(face.v[2]);
 
+	Vector3 projectionPoint = face.normal * face.distance; //projecting the origin onto the triangle(both are in Minkowski space)
+	float u, v, w;
+	Barycentric(a.p, b.p, c.p, projectionPoint, u, v, w); //finding the barycentric coordinate of this projection point to the triangle
+
+	//The contact points just have the same barycentric coordinate in their own triangles which  are composed by result coordinates of support function 
+	Vector3 localA = a.a * u + b.a * v + c.a * w;
+	Vector3 localB = a.b * u + b.b * v + c.b * w;
+	contact.penetration = (localA - localB).Length();
+	contact.normal		= (localA - localB).Normalised();
+	contact.localA		= localA - pair.PositionA();
+	contact.localB		= localB - pair.PositionB();
+}
+
+template<class PolytopeType, class PairType>
+static void ExpandPolytope(PolytopeType& polytope, int maxIterations, const PairType& pair, CollisionDetection::ContactPoint& contact)
+{
+	int closest_face = polytope.ClosestFace();
+
+	for (int iterations = 0; iterations < maxIterations; iterations++) {
 		//search normal to face that's closest to origin
-		Vector3 search_dir = faces[closest_face][3].p;
+		const EPAFace& face = polytope.GetFace(closest_face);
+		Vector3 search_dir = face.normal;
 
 		Point p;
-		CalculateSearchPoint(p, search_dir, coll1, coll2);
+		SearchPoint(p, search_dir, pair);
 
-		if (Vector3::Dot(p.p, search_dir) - min_dist < EPA_TOLERANCE) {
+		if (Vector3::Dot(p.p, search_dir) - face.distance < EPA_TOLERANCE) {
+			//Convergence (new point is not significantly further from origin)
+			AddFaceContact(polytope, closest_face, pair, contact);
+			return;
+		}
 
-		/*Core of calculating collision information*/
-			Plane closestPlane = Plane::PlaneFromTri(faces[closest_face][0].p, faces[closest_face][1].p, faces[closest_face][2].p); //plane of closest triangle face
-			Vector3 projectionPoint = closestPlane.ProjectPointOntoPlane(Vector3(0, 0, 0)); //projecting the origin onto the triangle(both are in Minkowski space)
-			float u, v, w;
-			Barycentric(faces[closest_face][0].p, faces[closest_face][1].p, faces[closest_face][2].p,
-				projectionPoint, u, v, w); //finding the barycentric coordinate of this projection point to the triangle
+		//Replace every face p can see with a fan of faces to p
+		if (!polytope.Expand(p, closest_face)) {
+			break; //out of room
+		}
+		closest_face = polytope.ClosestFace();
+	} //End for iterations
+	printf("EPA did not converge\n");
+	//Return most recent closest point
+	AddFaceContact(polytope, closest_face, pair, contact);
+}
 
-			//The contact points just have the same barycentric coordinate in their own triangles which  are composed by result coordinates of support function 
-			Vector3 localA = faces[closest_face][0].a * u + faces[closest_face][1].a * v + faces[closest_face][2].a * w;
-			Vector3 localB = faces[closest_face][0].b * u + faces[closest_face][1].b * v + faces[closest_face][2].b * w;
-			float penetration = (localA - localB).Length();
-			Vector3 normal = (localA - localB).Normalised();
+template<class PairType>
+static void EPAContact(Point& a, Point& b, Point& c, Point& d, const PairType& pair, CollisionDetection::ContactPoint& contact)
+{
+	if (pair.Rounded()) {
+		RoundedPolytope polytope;
+		polytope.Init(a, b, c, d); //Init with final simplex from GJK
+		ExpandPolytope(polytope, EPA_MAX_NUM_ITERATIONS_ROUNDED, pair, contact);
+	}
+	else {
+		Polytope polytope;
+		polytope.Init(a, b, c, d);
+		ExpandPolytope(polytope, EPA_MAX_NUM_ITERATIONS, pair, contact);
+	}
+}
 
-			//Convergence (new point is not significantly further from origin)
-			localA -= coll1->GetTransform().GetPosition();
-			localB -= coll2->GetTransform().GetPosition();
+void NCL::EPA(Point& a, Point& b, Point& c, Point& d, GameObject* coll1, GameObject* coll2, CollisionDetection::CollisionInfo& collisionInfo)
+{
+	CollisionDetection::ContactPoint contact;
+	EPAContact(a, b, c, d, ObjectPair{ coll1, coll2 }, contact);
+	collisionInfo.AddContactPoint(contact.localA, contact.localB, contact.normal, contact.penetration);
+}
 
-			collisionInfo.AddContactPoint(localA, localB, normal, penetration);
-		/*Core of calculating collision information*/
+//Contact manifold generation
+#define MANIFOLD_FACE_ALIGNMENT 0.95f	//cos of the largest angle between a reference face and the contact normal
+#define MANIFOLD_MAX_CLIP_POINTS 16
 
-			return;
+//Sutherland-Hodgman: keeps the part of points behind the plane through planePoint facing planeNormal.
+//Two points are clipped as a segment rather than a (degenerate) closed loop.
+static int ClipAgainstPlane(const Vector3* points, int numPoints, const Vector3& planePoint, const Vector3& planeNormal, Vector3* clipped)
+{
+	int numClipped = 0;
+	int numEdges = (numPoints > 2) ? numPoints : numPoints - 1;
+
+	if (numPoints == 1) {
+		if (Vector3::Dot(points[0] - planePoint, planeNormal) <= 0) {
+			clipped[numClipped++] = points[0];
 		}
+		return numClipped;
+	}
 
-		Point loose_edges[EPA_MAX_NUM_LOOSE_EDGES][2]; //keep track of edges we need to fix after removing faces
-		int num_loose_edges = 0;
-
-		//Find all triangles that are facing p
-		for (int i = 0; i < num_faces; i++)
-		{
-			if (Vector3::Dot(faces[i][3].p, p.p - faces[i][0].p) > 0) //triangle i faces p, remove it
-			{
-				//Add removed triangle's edges to loose edge list.
-				//If it's already there, remove it (both triangles it belonged to are gone)
-				for (int j = 0; j < 3; j++) //Three edges per face
-				{
-					Point current_edge[2] = { faces[i][j], faces[i][(j + 1) % 3] };
-					bool found_edge = false;
-					for (int k = 0; k < num_loose_edges; k++) //Check if current edge is already in list
-					{
-						if (loose_edges[k][1].p == current_edge[0].p && loose_edges[k][0].p == current_edge[1].p) {
-							loose_edges[k][0] = loose_edges[num_loose_edges - 1][0]; //Overwrite current edge
-							loose_edges[k][1] = loose_edges[num_loose_edges - 1][1]; //with last edge in list
-							num_loose_edges--;
-							found_edge = true;
-							k = num_loose_edges; //exit loop because edge can only be shared once
-						}
-					}//endfor loose_edges
-
-					if (!found_edge) { //add current edge to list
-						// assert(num_loose_edges<EPA_MAX_NUM_LOOSE_EDGES);
-						if (num_loose_edges >= EPA_MAX_NUM_LOOSE_EDGES) break;
-						loose_edges[num_loose_edges][0] = current_edge[0];
-						loose_edges[num_loose_edges][1] = current_edge[1];
-						num_loose_edges++;
-					}
-				}
+	for (int i = 0; i < numEdges; ++i) {
+		const Vector3& from = points[i];
+		const Vector3& to	= points[(i + 1) % numPoints];
+		float fromDist	= Vector3::Dot(from - planePoint, planeNormal);
+		float toDist	= Vector3::Dot(to - planePoint, planeNormal);
+
+		if (fromDist <= 0 && (numPoints > 2 || i == 0)) {
+			clipped[numClipped++] = from;
+		}
+		if ((fromDist < 0 && toDist > 0) || (fromDist > 0 && toDist < 0)) {
+			clipped[numClipped++] = from + (to - from) * (fromDist / (fromDist - toDist));
+		}
+		if (toDist <= 0 && numPoints == 2) {
+			clipped[numClipped++] = to;
+		}
+	}
+	return numClipped;
+}
+
+//How square on to the normal a feature sits: polygons by their face normal, segments by their direction
+static float FeatureAlignment(const Vector3* points, int numPoints, const Vector3& normal)
+{
+	if (numPoints >= 3) {
+		Vector3 faceNormal = Vector3::Cross(points[1] - points[0], points[2] - points[0]).Normalised();
+		return fabs(Vector3::Dot(faceNormal, normal));
+	}
+	if (numPoints == 2) {
+		return 1.0f - fabs(Vector3::Dot((points[1] - points[0]).Normalised(), normal));
+	}
+	return 0.0f;
+}
+
+void NCL::BuildContactManifold(GameObject* coll1, GameObject* coll2, CollisionDetection::CollisionInfo& collisionInfo)
+{
+	Vector3 normal = collisionInfo.point.normal; //from A to B
 
-				//Remove triangle i from list
-				faces[i][0] = faces[num_faces - 1][0];
-				faces[i][1] = faces[num_faces - 1][1];
-				faces[i][2] = faces[num_faces - 1][2];
-				faces[i][3] = faces[num_faces - 1][3];
-				num_faces--;
-				i--;
-			}//endif p can see triangle i
-		}//endfor num_faces
-
-		//Reconstruct polytope with p added
-		for (int i = 0; i < num_loose_edges; i++)
-		{
-			// assert(num_faces<EPA_MAX_NUM_FACES);
-			if (num_faces >= EPA_MAX_NUM_FACES) break;
-			faces[num_faces][0] = loose_edges[i][0];
-			faces[num_faces][1] = loose_edges[i][1];
-			faces[num_faces][2] = p;
-			faces[num_faces][3].p = Vector3::Cross(loose_edges[i][0].p - loose_edges[i][1].p, loose_edges[i][0].p - p.p).Normalised();
-
-			//Check for wrong normal to maintain CCW winding
-			float bias = 0.000001; //in case dot result is only slightly < 0 (because origin is on face)
-			if (Vector3::Dot(faces[num_faces][0].p, faces[num_faces][3].p) + bias < 0) {
-				Point temp = faces[num_faces][0];
-				faces[num_faces][0] = faces[num_faces][1];
-				faces[num_faces][1] = temp;
-				faces[num_faces][3].p = -faces[num_faces][3].p;
+	Vector3 featureA[MAX_FEATURE_POINTS];
+	Vector3 featureB[MAX_FEATURE_POINTS];
+	int numA = coll1->GetBoundingVolume()->GetFeature(normal, coll1->GetTransform(), featureA);
+	int numB = coll2->GetBoundingVolume()->GetFeature(-normal, coll2->GetTransform(), featureB);
+
+	if (numA < 2 || numB < 2) {
+		return; //a vertex or a rounded surface, the EPA point is the whole contact
+	}
+
+	//The feature with more points (or squarer on to the normal) is the reference, the other gets clipped to it
+	float alignmentA = FeatureAlignment(featureA, numA, normal);
+	float alignmentB = FeatureAlignment(featureB, numB, normal);
+	bool referenceIsA = (numA > numB) || (numA == numB && alignmentA >= alignmentB);
+
+	const Vector3*	reference		= referenceIsA ? featureA : featureB;
+	const Vector3*	incident		= referenceIsA ? featureB : featureA;
+	int				numReference	= referenceIsA ? numA : numB;
+	int				numIncident		= referenceIsA ? numB : numA;
+	Vector3			referenceNormal = referenceIsA ? normal : -normal; //out of the reference object
+
+	if ((referenceIsA ? alignmentA : alignmentB) < MANIFOLD_FACE_ALIGNMENT) {
+		return; //edge on contact, clipping would invent points
+	}
+	if (numReference == 2 && fabs(Vector3::Dot((reference[1] - reference[0]).Normalised(), (incident[1] - incident[0]).Normalised())) < MANIFOLD_FACE_ALIGNMENT) {
+		return; //crossing segments only touch at one point
+	}
+
+	//Clip the incident feature against the side planes of the reference feature
+	Vector3 clipBuffers[2][MANIFOLD_MAX_CLIP_POINTS];
+	int numClipped = numIncident;
+	for (int i = 0; i < numIncident; ++i) {
+		clipBuffers[0][i] = incident[i];
+	}
+	int current = 0;
+
+	if (numReference == 2) {
+		Vector3 along = reference[1] - reference[0];
+		numClipped = ClipAgainstPlane(clipBuffers[current], numClipped, reference[1], along, clipBuffers[1 - current]);
+		current = 1 - current;
+		numClipped = ClipAgainstPlane(clipBuffers[current], numClipped, reference[0], -along, clipBuffers[1 - current]);
+		current = 1 - current;
+	}
+	else {
+		Vector3 centre;
+		for (int i = 0; i < numReference; ++i) {
+			centre += reference[i];
+		}
+		centre = centre / (float)numReference;
+
+		for (int i = 0; i < numReference && numClipped > 0; ++i) {
+			const Vector3& from = reference[i];
+			const Vector3& to	= reference[(i + 1) % numReference];
+			Vector3 sideNormal = Vector3::Cross(to - from, normal);
+			if (Vector3::Dot(sideNormal, centre - from) > 0) {
+				sideNormal = -sideNormal;
 			}
-			num_faces++;
+			numClipped = ClipAgainstPlane(clipBuffers[current], numClipped, from, sideNormal, clipBuffers[1 - current]);
+			current = 1 - current;
 		}
-	} //End for iterations
-	printf("EPA did not converge\n");
-	//Return most recent closest point
-	Vector3 search_dir = faces[closest_face][3].p;
+	}
 
-	Point p;
-	CalculateSearchPoint(p, search_dir, coll1, coll2);
+	//Only the clipped points behind the reference surface are in contact
+	Vector3 referencePoint = reference[0];
+	for (int i = 1; i < numReference; ++i) {
+		if (Vector3::Dot(reference[i], referenceNormal) > Vector3::Dot(referencePoint, referenceNormal)) {
+			referencePoint = reference[i];
+		}
+	}
 
-	Plane closestPlane = Plane::PlaneFromTri(faces[closest_face][0].p, faces[closest_face][1].p, faces[closest_face][2].p);
-	Vector3 projectionPoint = closestPlane.ProjectPointOntoPlane(Vector3(0, 0, 0));
-	float u, v, w;
-	Barycentric(faces[closest_face][0].p, faces[closest_face][1].p, faces[closest_face][2].p,
-		projectionPoint, u, v, w);
-	Vector3 localA = faces[closest_face][0].a * u + faces[closest_face][1].a * v + faces[closest_face][2].a * w;
-	Vector3 localB = faces[closest_face][0].b * u + faces[closest_face][1].b * v + faces[closest_face][2].b * w;
-	float penetration = (localA - localB).Length();
-	Vector3 normal = (localA - localB).Normalised();
+	CollisionDetection::ContactPoint contacts[MANIFOLD_MAX_CLIP_POINTS];
+	int numContacts = 0;
+	for (int i = 0; i < numClipped; ++i) {
+		const Vector3& incidentPoint = clipBuffers[current][i];
+		float penetration = Vector3::Dot(referencePoint - incidentPoint, referenceNormal);
+		if (penetration < 0) {
+			continue;
+		}
+		Vector3 referenceSurfacePoint = incidentPoint + referenceNormal * penetration;
 
-	collisionInfo.AddContactPoint(localA, localB, normal, penetration);
+		CollisionDetection::ContactPoint& c = contacts[numContacts++];
+		c.localA		= (referenceIsA ? referenceSurfacePoint : incidentPoint) - coll1->GetTransform().GetPosition();
+		c.localB		= (referenceIsA ? incidentPoint : referenceSurfacePoint) - coll2->GetTransform().GetPosition();
+		c.normal		= normal;
+		c.penetration	= penetration;
+	}
 
-	return;
+	if (numContacts < 2) {
+		return; //nothing better than the EPA point
+	}
+	CollisionDetection::ReduceContactPoints(contacts, numContacts);
+
+	CollisionDetection::ContactPoint epaPoint = collisionInfo.point;
+	collisionInfo.ClearContactPoints();
+	for (int i = 0; i < numContacts; ++i) {
+		collisionInfo.AddContactPoint(contacts[i].localA, contacts[i].localB, contacts[i].normal, contacts[i].penetration);
+	}
+	//Rounded features (cylinder caps) are only approximated by their points, EPA knows the real depth
+	if (epaPoint.penetration > collisionInfo.point.penetration) {
+		collisionInfo.point = epaPoint;
+	}
 }
 
-void NCL::CalculateSearchPoint(Point& point, Vector3& search_dir, GameObject* coll1, GameObject* coll2)
+void NCL::CalculateSearchPoint(Point& point, const Vector3& search_dir, GameObject* coll1, GameObject* coll2)
 {
-	point.b = coll2->GetBoundingVolume()->Support(search_dir, coll2->GetTransform());
-	point.a = coll1->GetBoundingVolume()->Support(-search_dir, coll1->GetTransform());
-	point.p = point.b - point.a;
+	SearchPoint(point, search_dir, ObjectPair{ coll1, coll2 });
+}
+
+//Batched queries
+//Same maths as each volume's own Support, so batched and single pair queries agree exactly
+Vector3 GJKShape::Support(const Vector3& dir) const
+{
+	switch (type) {
+		case VolumeType::Sphere:	return SphereSupport(*this).Support(dir);
+		case VolumeType::Capsule:	return CapsuleSupport(*this).Support(dir);
+		case VolumeType::Cylinder:	return CylinderSupport(*this).Support(dir);
+		default:					return BoxSupport(*this).Support(dir); //AABB, OBB
+	}
+}
+
+Vector3 GJKShape::CoreSupport(const Vector3& dir) const
+{
+	switch (type) {
+		case VolumeType::Sphere:	return SphereSupport(*this).CoreSupport(dir);
+		case VolumeType::Capsule:	return CapsuleSupport(*this).CoreSupport(dir);
+		case VolumeType::Cylinder:	return CylinderSupport(*this).CoreSupport(dir);
+		default:					return BoxSupport(*this).CoreSupport(dir);
+	}
+}
+
+bool NCL::ExtractGJKShape(GameObject* object, GJKShape& shape)
+{
+	const CollisionVolume* volume = object->GetBoundingVolume();
+	if (!volume) {
+		return false;
+	}
+	return ExtractGJKShape(volume, object->GetTransform(), shape);
+}
+
+bool NCL::ExtractGJKShape(const CollisionVolume* volume, const Transform& transform, GJKShape& shape)
+{
+	shape.type			= volume->type;
+	shape.halfSizes		= Vector3();
+	shape.radius		= 0.0f;
+	shape.halfHeight	= 0.0f;
+
+	switch (volume->type) {
+		case VolumeType::AABB:
+			shape.halfSizes = ((const AABBVolume*)volume)->GetHalfDimensions();
+			break;
+		case VolumeType::OBB:
+			shape.halfSizes = ((const OBBVolume*)volume)->GetHalfDimensions();
+			break;
+		case VolumeType::Sphere:
+			shape.radius = ((const SphereVolume*)volume)->GetRadius();
+			break;
+		case VolumeType::Capsule:
+			shape.radius		= ((const CapsuleVolume*)volume)->GetRadius();
+			shape.halfHeight	= ((const CapsuleVolume*)volume)->GetHalfHeight();
+			break;
+		case VolumeType::Cylinder:
+			shape.radius		= ((const CylinderVolume*)volume)->GetRadius();
+			shape.halfHeight	= ((const CylinderVolume*)volume)->GetHalfHeight();
+			break;
+		default:
+			return false;
+	}
+	shape.margin = volume->GetMargin();
+
+	shape.position		= transform.GetPosition();
+	shape.rotation		= transform.GetRotMatrix();
+	shape.invRotation	= transform.GetInvRotMatrix();
+	return true;
+}
+
+//Pairs queued up for the 4 wide search
+struct GJKLanes {
+	int				index[4];
+	const GJKPair*	pairs[4];
+	Vector3			searchDirs[4];
+	int				count;
+#ifdef _DEBUG
+	bool			check;		//checking this batch's lanes against the scalar search
+	int				checked;
+	int				mismatches;
+#endif
+};
+
+#ifdef _DEBUG
+//The scalar search on one pair, to check the 4 wide kernel's lanes against
+struct SearchQuery {
+	Vector3 searchDir;
+	Point	simplex[4];
+	int		status;
+
+	template<class PairType>
+	void Run(const PairType& pair) {
+		status = GJKSearch(pair, simplex[0], simplex[1], simplex[2], simplex[3], searchDir);
+	}
+};
+
+static bool SameBits(const Vector3& a, const Vector3& b)
+{
+	return memcmp(&a, &b, sizeof(Vector3)) == 0;
+}
+
+static bool SameBits(const Point& a, const Point& b)
+{
+	return SameBits(a.p, b.p) && SameBits(a.a, b.a) && SameBits(a.b, b.b);
+}
+
+//The kernel is meant to give bit for bit what the scalar search does, so a lane that doesn't is a bug
+static void CheckLanes(GJKLanes& lanes, const Vector3* startDirs, Point simplices[4][4], const int* status)
+{
+	for (int lane = 0; lane < lanes.count; ++lane) {
+		SearchQuery query;
+		query.searchDir = startDirs[lane];
+		DispatchTypedPair(lanes.pairs[lane]->a, lanes.pairs[lane]->b, query);
+
+		bool same = query.status == status[lane] && SameBits(query.searchDir, lanes.searchDirs[lane]);
+		for (int i = 0; i < 4 && same && query.status == GJK_ENCLOSED; ++i) {
+			same = SameBits(query.simplex[i], simplices[lane][i]);
+		}
+		lanes.checked++;
+		lanes.mismatches += same ? 0 : 1;
+	}
+}
+#endif
+
+static void RunLanes(GJKLanes& lanes, const GJKPair* pairs, GJKBatchResult* results, GJKCache** caches)
+{
+	for (int lane = lanes.count; lane < 4; ++lane) {
+		lanes.pairs[lane]		= lanes.pairs[0]; //pad the last group out, results are ignored
+		lanes.searchDirs[lane]	= lanes.searchDirs[0];
+	}
+	Point	simplices[4][4];
+	int		status[4];
+#ifdef _DEBUG
+	Vector3 startDirs[4] = { lanes.searchDirs[0], lanes.searchDirs[1], lanes.searchDirs[2], lanes.searchDirs[3] };
+#endif
+	GJKSearch4(lanes.pairs, lanes.searchDirs, simplices, status);
+#ifdef _DEBUG
+	if (lanes.check) {
+		CheckLanes(lanes, startDirs, simplices, status);
+	}
+#endif
+
+	//Then finish each pair the same way GJKIntersection would
+	for (int lane = 0; lane < lanes.count; ++lane) {
+		int index = lanes.index[lane];
+		FinishQuery query = { status[lane], simplices[lane], &lanes.searchDirs[lane], caches ? caches[index] : nullptr, &results[index] };
+		DispatchTypedPair(pairs[index].a, pairs[index].b, query);
+	}
+	lanes.count = 0;
+}
+
+void NCL::GJKBatch(const GJKPair* pairs, GJKBatchResult* results, int count, GJKCache** caches)
+{
+	bool useSimd = GJKSimdAvailable();
+	GJKLanes lanes;
+	lanes.count = 0;
+#ifdef _DEBUG
+	lanes.check			= useSimd && GJKSimdCheckPending();
+	lanes.checked		= 0;
+	lanes.mismatches	= 0;
+#endif
+
+	for (int i = 0; i < count; ++i) {
+		ShapePair pair = { &pairs[i].a, &pairs[i].b };
+		GJKCache* cache = caches ? caches[i] : nullptr;
+
+		//Only the plain GJK search is done 4 wide, everything else is a whole query on the typed pair.
+		//Spheres have a margin, so in margin mode only box pairs get this far.
+		if (!useSimd || !GJKSimdCanBatch(pairs[i]) || UseMarginMode(pair.MarginA(), pair.MarginB())) {
+			ContactQuery query(cache);
+			DispatchTypedPair(pairs[i].a, pairs[i].b, query);
+			results[i].colliding	= query.colliding;
+			results[i].contact		= query.contact;
+			continue;
+		}
+
+		Point simplex[4];
+		Vector3 search_dir;
+		int status = GJKWarmStart(pair, simplex[0], simplex[1], simplex[2], simplex[3], cache, search_dir);
+		if (status == GJK_UNDECIDED) {
+			lanes.index[lanes.count]		= i;
+			lanes.pairs[lanes.count]		= &pairs[i];
+			lanes.searchDirs[lanes.count]	= search_dir;
+			if (++lanes.count == 4) {
+				RunLanes(lanes, pairs, results, caches);
+			}
+			continue;
+		}
+		FinishQuery query = { status, simplex, nullptr, cache, &results[i] };
+		DispatchTypedPair(pairs[i].a, pairs[i].b, query);
+	}
+	if (lanes.count > 0) {
+		RunLanes(lanes, pairs, results, caches);
+	}
+#ifdef _DEBUG
+	if (lanes.checked > 0) {
+		std::cout << "GJK SIMD check: " << lanes.mismatches << " of " << lanes.checked << " lanes differ from the scalar search" << std::endl;
+		GJKSimdCheckDone();
+	}
+#endif
 }
@@ -3,6 +3,8 @@
 #include "GameObject.h"
 #include "CollisionDetection.h"
 
+#define GJK_MAX_NUM_ITERATIONS 64
+
 namespace NCL {
 	struct Point {
 		Vector3 p; //Conserve Minkowski Difference
@@ -13,16 +15,99 @@ namespace NCL {
 	using namespace NCL::Maths;
 	using namespace NCL::CSC8503;
 
+	//Per-pair state carried from one GJK query to the next. Resting pairs are tested every substep with
+	//almost identical transforms, so the last enclosing simplex usually still encloses the origin.
+	struct GJKCache {
+		Vector3 localA[4];			//Support points of the last enclosing simplex, in object A's local space
+		Vector3 localB[4];			//Support points of the last enclosing simplex, in object B's local space
+		int		simplexSize = 0;	//4 if the last query ended on an enclosing tetrahedron, 0 otherwise
+
+		Vector3 lastSearchDir;		//Search direction the last query finished on, seeds the next cold start
+
+		Vector3 separatingAxis;		//Axis that proved the pair apart on the last query
+		bool	separated = false;	//Whether separatingAxis is valid, tested before running the full GJK loop
+		int		framesUnused = 0;	//Frames since the pair was last queried, used to evict stale entries
+	};
+
+	//Result of a GJK distance query
+	struct GJKDistanceResult {
+		Vector3 closestA;		//World space point on object A closest to object B
+		Vector3 closestB;		//World space point on object B closest to object A
+		float	distance;		//Separation distance, 0 if the shapes overlap
+		bool	overlapping;
+	};
+
+	//Plain copy of a collision volume and its transform, so batched queries don't chase
+	//GameObject -> CollisionVolume -> Transform pointers or make virtual Support calls
+	struct GJKShape {
+		VolumeType	type;
+		Vector3		position;
+		Matrix3		rotation;
+		Matrix3		invRotation;
+		Vector3		halfSizes;	//AABB, OBB
+		float		radius;		//Sphere, capsule, cylinder
+		float		halfHeight;	//Capsule, cylinder
+		float		margin;		//CollisionVolume::GetMargin
+
+		Vector3 Support(const Vector3& dir) const;
+		Vector3 CoreSupport(const Vector3& dir) const;
+	};
+
+	struct GJKPair {
+		GJKShape a;
+		GJKShape b;
+	};
+
+	struct GJKBatchResult {
+		bool							colliding;
+		CollisionDetection::ContactPoint contact; //EPA contact, only valid if colliding
+	};
+
 	//GilbertCJohnsonCKeerthi distance algorithm
-	bool GJKCalculation(GameObject* coll1, GameObject* coll2, CollisionDetection::CollisionInfo& collisionInfo); 
+	bool GJKCalculation(GameObject* coll1, GameObject* coll2, CollisionDetection::CollisionInfo& collisionInfo, GJKCache* cache = nullptr); 
+
+	//Copies what GJK needs out of an object. Returns false for volumes that can only be queried through GameObjects.
+	bool ExtractGJKShape(GameObject* object, GJKShape& shape);
+	bool ExtractGJKShape(const CollisionVolume* volume, const Transform& transform, GJKShape& shape);
+
+	//GJKCalculation's test on two volumes that needn't be a GameObject's own, like the children of a compound.
+	//The contact's localA and localB are offsets from the transforms' positions.
+	bool GJKContact(CollisionVolume* volA, const Transform& transformA, CollisionVolume* volB, const Transform& transformB, CollisionDetection::ContactPoint& contact);
+
+	//Margin mode, on by default: pairs with a rounded shape find their contact from the distance between
+	//the shapes' cores, and only fall back to EPA on the full shapes when the cores themselves overlap
+	void SetGJKMarginMode(bool enabled);
+	bool GetGJKMarginMode();
+
+	//Runs GJKCalculation's test on count pairs, writing results[i] for pairs[i]. caches can be null, as can any entry in it.
+	void GJKBatch(const GJKPair* pairs, GJKBatchResult* results, int count, GJKCache** caches = nullptr);
+
+	//GJK distance mode: closest points and separation distance of two shapes. Returns true if they are apart.
+	bool GJKDistance(GameObject* coll1, GameObject* coll2, GJKDistanceResult& result, GJKCache* cache = nullptr);
 
 	//Internal functions used in the GJK algorithm
 	void update_simplex3(Point& a, Point& b, Point& c, Point& d, int& simp_dim, Vector3& search_dir);
 	bool update_simplex4(Point& a, Point& b, Point& c, Point& d, int& simp_dim, Vector3& search_dir);
 
+	//Reduces the simplex to the feature closest to the origin, returning that closest point and the
+	//barycentric weight of each remaining point. Returns false if the simplex encloses the origin.
+	bool closest_on_simplex(Point* simplex, float* weights, int& simp_dim, Vector3& closest);
+
+	//Warm start helpers: store the enclosing simplex in local space, and rebuild it from the current transforms
+	void StoreSimplex(GJKCache& cache, const Point& a, const Point& b, const Point& c, const Point& d, GameObject* coll1, GameObject* coll2);
+	bool RestoreSimplex(const GJKCache& cache, Point& a, Point& b, Point& c, Point& d, GameObject* coll1, GameObject* coll2);
+
+	//Separating axis early out: two support calls to check a previously separating axis still separates the pair
+	bool IsSeparatingAxis(const Vector3& axis, GameObject* coll1, GameObject* coll2);
+	void RecordSeparatingAxis(GJKCache& cache, const Vector3& axis);
+
 	//Expanding Polytope Algorithm. 
 	void EPA(Point& a, Point& b, Point& c, Point& d, GameObject* coll1, GameObject* coll2, CollisionDetection::CollisionInfo& collisionInfo);
 
+	//Replaces the single EPA contact with up to MAX_CONTACT_POINTS contacts, by clipping the features of both
+	//shapes facing each other along the contact normal. Leaves it alone for vertex, edge on and rounded contacts.
+	void BuildContactManifold(GameObject* coll1, GameObject* coll2, CollisionDetection::CollisionInfo& collisionInfo);
+
 	//Calculate the Minkowski Difference and conserve the the support function results at the same time.
-	void CalculateSearchPoint(Point& point, Vector3& search_dir, GameObject* coll1, GameObject* coll2);
+	void CalculateSearchPoint(Point& point, const Vector3& search_dir, GameObject* coll1, GameObject* coll2);
 }
\ No newline at end of file
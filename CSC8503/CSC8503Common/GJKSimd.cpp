@@ -0,0 +1,375 @@
+#include "GJKSimd.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define GJK_SIMD_SSE2
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+using namespace NCL;
+
+static bool simdEnabled = true;
+
+#ifdef _DEBUG
+static bool checkPending = true;
+
+bool NCL::GJKSimdCheckPending()
+{
+	return checkPending;
+}
+
+void NCL::GJKSimdCheckDone()
+{
+	checkPending = false;
+}
+#endif
+
+void NCL::SetGJKSimdEnabled(bool enabled)
+{
+	simdEnabled = enabled;
+#ifdef _DEBUG
+	checkPending = true;
+#endif
+}
+
+bool NCL::GetGJKSimdEnabled()
+{
+	return simdEnabled;
+}
+
+static bool IsBoxOrSphere(VolumeType type)
+{
+	return type == VolumeType::AABB || type == VolumeType::OBB || type == VolumeType::Sphere;
+}
+
+bool NCL::GJKSimdCanBatch(const GJKPair& pair)
+{
+	return IsBoxOrSphere(pair.a.type) && IsBoxOrSphere(pair.b.type);
+}
+
+#ifdef GJK_SIMD_SSE2
+
+bool NCL::GJKSimdAvailable()
+{
+	static int supported = -1;
+	if (supported < 0) {
+		int info[4] = { 0, 0, 0, 0 };
+#ifdef _MSC_VER
+		__cpuid(info, 1);
+#else
+		__cpuid(1, info[0], info[1], info[2], info[3]);
+#endif
+		supported = (info[3] & (1 << 26)) ? 1 : 0; //EDX bit 26 is SSE2
+	}
+	return supported == 1 && simdEnabled;
+}
+
+/*
+Four Vector3s, one per lane, stored as xxxx yyyy zzzz. All the maths below is written
+to match Vector3 and Matrix3 operation for operation (same order of additions, unary
+minus as a sign flip, and so on), which is what keeps the lanes bit identical to the
+scalar code. Don't tidy it up into anything cleverer.
+*/
+struct Vector3x4 {
+	__m128 x;
+	__m128 y;
+	__m128 z;
+};
+
+struct Matrix3x4 {
+	__m128 array[9];
+};
+
+struct Point4 {
+	Vector3x4 p;
+	Vector3x4 a;
+	Vector3x4 b;
+};
+
+struct Shape4 {
+	Vector3x4	position;
+	Vector3x4	halfSizes;
+	Matrix3x4	rotation;
+	Matrix3x4	invRotation;
+	__m128		radius;
+	__m128		sphere; //lane mask, set for spheres
+};
+
+static inline __m128 Negate(__m128 v)
+{
+	return _mm_xor_ps(v, _mm_set1_ps(-0.0f));
+}
+
+static inline __m128 Select(__m128 mask, __m128 t, __m128 f)
+{
+	return _mm_or_ps(_mm_and_ps(mask, t), _mm_andnot_ps(mask, f));
+}
+
+static inline Vector3x4 Set(const Vector3& v)
+{
+	return { _mm_set1_ps(v.x), _mm_set1_ps(v.y), _mm_set1_ps(v.z) };
+}
+
+static inline Vector3x4 Add(const Vector3x4& a, const Vector3x4& b)
+{
+	return { _mm_add_ps(a.x, b.x), _mm_add_ps(a.y, b.y), _mm_add_ps(a.z, b.z) };
+}
+
+static inline Vector3x4 Sub(const Vector3x4& a, const Vector3x4& b)
+{
+	return { _mm_sub_ps(a.x, b.x), _mm_sub_ps(a.y, b.y), _mm_sub_ps(a.z, b.z) };
+}
+
+static inline Vector3x4 Scale(const Vector3x4& a, __m128 s)
+{
+	return { _mm_mul_ps(a.x, s), _mm_mul_ps(a.y, s), _mm_mul_ps(a.z, s) };
+}
+
+static inline Vector3x4 Negate(const Vector3x4& a)
+{
+	return { Negate(a.x), Negate(a.y), Negate(a.z) };
+}
+
+static inline __m128 Dot(const Vector3x4& a, const Vector3x4& b)
+{
+	return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a.x, b.x), _mm_mul_ps(a.y, b.y)), _mm_mul_ps(a.z, b.z));
+}
+
+static inline Vector3x4 Cross(const Vector3x4& a, const Vector3x4& b)
+{
+	return {
+		_mm_sub_ps(_mm_mul_ps(a.y, b.z), _mm_mul_ps(a.z, b.y)),
+		_mm_sub_ps(_mm_mul_ps(a.z, b.x), _mm_mul_ps(a.x, b.z)),
+		_mm_sub_ps(_mm_mul_ps(a.x, b.y), _mm_mul_ps(a.y, b.x))
+	};
+}
+
+static inline __m128 IsZero(const Vector3x4& a)
+{
+	__m128 zero = _mm_setzero_ps();
+	return _mm_and_ps(_mm_and_ps(_mm_cmpeq_ps(a.x, zero), _mm_cmpeq_ps(a.y, zero)), _mm_cmpeq_ps(a.z, zero));
+}
+
+static inline Vector3x4 Select(__m128 mask, const Vector3x4& t, const Vector3x4& f)
+{
+	return { Select(mask, t.x, f.x), Select(mask, t.y, f.y), Select(mask, t.z, f.z) };
+}
+
+static inline Point4 Select(__m128 mask, const Point4& t, const Point4& f)
+{
+	return { Select(mask, t.p, f.p), Select(mask, t.a, f.a), Select(mask, t.b, f.b) };
+}
+
+static inline Vector3x4 Multiply(const Matrix3x4& m, const Vector3x4& v)
+{
+	return {
+		_mm_add_ps(_mm_add_ps(_mm_mul_ps(v.x, m.array[0]), _mm_mul_ps(v.y, m.array[3])), _mm_mul_ps(v.z, m.array[6])),
+		_mm_add_ps(_mm_add_ps(_mm_mul_ps(v.x, m.array[1]), _mm_mul_ps(v.y, m.array[4])), _mm_mul_ps(v.z, m.array[7])),
+		_mm_add_ps(_mm_add_ps(_mm_mul_ps(v.x, m.array[2]), _mm_mul_ps(v.y, m.array[5])), _mm_mul_ps(v.z, m.array[8]))
+	};
+}
+
+static Shape4 LoadShapes(const GJKShape* shapes[4])
+{
+	Shape4 s;
+	s.position.x	= _mm_setr_ps(shapes[0]->position.x, shapes[1]->position.x, shapes[2]->position.x, shapes[3]->position.x);
+	s.position.y	= _mm_setr_ps(shapes[0]->position.y, shapes[1]->position.y, shapes[2]->position.y, shapes[3]->position.y);
+	s.position.z	= _mm_setr_ps(shapes[0]->position.z, shapes[1]->position.z, shapes[2]->position.z, shapes[3]->position.z);
+	s.halfSizes.x	= _mm_setr_ps(shapes[0]->halfSizes.x, shapes[1]->halfSizes.x, shapes[2]->halfSizes.x, shapes[3]->halfSizes.x);
+	s.halfSizes.y	= _mm_setr_ps(shapes[0]->halfSizes.y, shapes[1]->halfSizes.y, shapes[2]->halfSizes.y, shapes[3]->halfSizes.y);
+	s.halfSizes.z	= _mm_setr_ps(shapes[0]->halfSizes.z, shapes[1]->halfSizes.z, shapes[2]->halfSizes.z, shapes[3]->halfSizes.z);
+	for (int i = 0; i < 9; ++i) {
+		s.rotation.array[i]		= _mm_setr_ps(shapes[0]->rotation.array[i], shapes[1]->rotation.array[i], shapes[2]->rotation.array[i], shapes[3]->rotation.array[i]);
+		s.invRotation.array[i]	= _mm_setr_ps(shapes[0]->invRotation.array[i], shapes[1]->invRotation.array[i], shapes[2]->invRotation.array[i], shapes[3]->invRotation.array[i]);
+	}
+	s.radius = _mm_setr_ps(shapes[0]->radius, shapes[1]->radius, shapes[2]->radius, shapes[3]->radius);
+
+	__m128i sphereMask = _mm_setr_epi32(
+		shapes[0]->type == VolumeType::Sphere ? -1 : 0,
+		shapes[1]->type == VolumeType::Sphere ? -1 : 0,
+		shapes[2]->type == VolumeType::Sphere ? -1 : 0,
+		shapes[3]->type == VolumeType::Sphere ? -1 : 0);
+	s.sphere = _mm_castsi128_ps(sphereMask);
+	return s;
+}
+
+//Both support functions are worked out for every lane, and the right one picked per lane
+static Vector3x4 Support(const Shape4& s, const Vector3x4& dir)
+{
+	__m128 zero = _mm_setzero_ps();
+
+	//Box: corner along dir in model space (OBBVolume::Support)
+	Vector3x4 localDir = Multiply(s.invRotation, dir);
+	Vector3x4 corner;
+	corner.x = Select(_mm_cmpgt_ps(localDir.x, zero), s.halfSizes.x, Negate(s.halfSizes.x));
+	corner.y = Select(_mm_cmpgt_ps(localDir.y, zero), s.halfSizes.y, Negate(s.halfSizes.y));
+	corner.z = Select(_mm_cmpgt_ps(localDir.z, zero), s.halfSizes.z, Negate(s.halfSizes.z));
+	Vector3x4 box = Add(Multiply(s.rotation, corner), s.position);
+
+	//Sphere: dir.Normalised() * radius (SphereVolume::Support)
+	__m128 length	= _mm_sqrt_ps(Dot(dir, dir));
+	__m128 invLength = _mm_div_ps(_mm_set1_ps(1.0f), length);
+	Vector3x4 normalised = Select(_mm_cmpneq_ps(length, zero), Scale(dir, invLength), dir);
+	Vector3x4 sphere = Add(Scale(normalised, s.radius), s.position);
+
+	return Select(s.sphere, sphere, box);
+}
+
+static inline Point4 SearchPoint(const Shape4& shapeA, const Shape4& shapeB, const Vector3x4& search_dir)
+{
+	Point4 point;
+	point.b = Support(shapeB, search_dir);
+	point.a = Support(shapeA, Negate(search_dir));
+	point.p = Sub(point.b, point.a);
+	return point;
+}
+
+static void StoreLane(const Vector3x4& v, int lane, Vector3& out)
+{
+	float x[4], y[4], z[4];
+	_mm_storeu_ps(x, v.x);
+	_mm_storeu_ps(y, v.y);
+	_mm_storeu_ps(z, v.z);
+	out = Vector3(x[lane], y[lane], z[lane]);
+}
+
+static void StoreLane(const Point4& p, int lane, Point& out)
+{
+	StoreLane(p.p, lane, out.p);
+	StoreLane(p.a, lane, out.a);
+	StoreLane(p.b, lane, out.b);
+}
+
+void NCL::GJKSearch4(const GJKPair* const pairs[4], Vector3 searchDirs[4], Point simplices[4][4], int status[4])
+{
+	const GJKShape* shapesA[4] = { &pairs[0]->a, &pairs[1]->a, &pairs[2]->a, &pairs[3]->a };
+	const GJKShape* shapesB[4] = { &pairs[0]->b, &pairs[1]->b, &pairs[2]->b, &pairs[3]->b };
+	Shape4 shapeA = LoadShapes(shapesA);
+	Shape4 shapeB = LoadShapes(shapesB);
+
+	__m128 zero = _mm_setzero_ps();
+	__m128 all	= _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+	Vector3x4 search_dir;
+	search_dir.x = _mm_setr_ps(searchDirs[0].x, searchDirs[1].x, searchDirs[2].x, searchDirs[3].x);
+	search_dir.y = _mm_setr_ps(searchDirs[0].y, searchDirs[1].y, searchDirs[2].y, searchDirs[3].y);
+	search_dir.z = _mm_setr_ps(searchDirs[0].z, searchDirs[1].z, searchDirs[2].z, searchDirs[3].z);
+
+	Point4 a = { Set(Vector3()), Set(Vector3()), Set(Vector3()) };
+	Point4 b = a;
+	Point4 c = a;
+	Point4 d = a;
+
+	//Initial line segment, as in GJKSearch
+	c = SearchPoint(shapeA, shapeB, search_dir);
+	search_dir = Negate(c.p);
+	b = SearchPoint(shapeA, shapeB, search_dir);
+
+	__m128 separated	= _mm_cmplt_ps(Dot(b.p, search_dir), zero);
+	__m128 enclosed		= zero;
+	__m128 done			= separated;
+
+	Vector3x4 cb = Sub(c.p, b.p);
+	Vector3x4 perpendicular = Cross(Cross(cb, Negate(b.p)), cb);
+	Vector3x4 normalX = Cross(cb, Set(Vector3(1, 0, 0)));
+	Vector3x4 normalZ = Cross(cb, Set(Vector3(0, 0, -1)));
+	perpendicular	= Select(IsZero(perpendicular), Select(IsZero(normalX), normalZ, normalX), perpendicular);
+	search_dir		= Select(done, search_dir, perpendicular);
+
+	__m128i simp_dim = _mm_set1_epi32(2);
+
+	for (int iterations = 0; iterations < GJK_MAX_NUM_ITERATIONS && _mm_movemask_ps(done) != 0xF; iterations++) {
+		Point4 newPoint = SearchPoint(shapeA, shapeB, search_dir);
+
+		__m128 missed = _mm_andnot_ps(done, _mm_cmplt_ps(Dot(newPoint.p, search_dir), zero));
+		separated	= _mm_or_ps(separated, missed);
+		done		= _mm_or_ps(done, missed);
+
+		__m128 live = _mm_andnot_ps(done, all);
+		a			= Select(live, newPoint, a);
+		simp_dim	= _mm_sub_epi32(simp_dim, _mm_castps_si128(live)); //live lanes are -1
+
+		__m128 is3 = _mm_and_ps(live, _mm_castsi128_ps(_mm_cmpeq_epi32(simp_dim, _mm_set1_epi32(3))));
+		__m128 is4 = _mm_and_ps(live, _mm_castsi128_ps(_mm_cmpeq_epi32(simp_dim, _mm_set1_epi32(4))));
+
+		Vector3x4 ab = Sub(b.p, a.p);
+		Vector3x4 ac = Sub(c.p, a.p);
+		Vector3x4 ad = Sub(d.p, a.p);
+		Vector3x4 AO = Negate(a.p);
+
+		//update_simplex3
+		Vector3x4 n = Cross(ab, ac);
+		__m128 edgeAB	= _mm_cmpgt_ps(Dot(Cross(ab, n), AO), zero);
+		__m128 edgeAC	= _mm_andnot_ps(edgeAB, _mm_cmpgt_ps(Dot(Cross(n, ac), AO), zero));
+		__m128 face		= _mm_andnot_ps(_mm_or_ps(edgeAB, edgeAC), all);
+		__m128 above	= _mm_and_ps(face, _mm_cmpgt_ps(Dot(n, AO), zero));
+		__m128 below	= _mm_andnot_ps(above, face);
+
+		Point4 b3 = Select(_mm_or_ps(edgeAC, face), a, b);
+		Point4 c3 = Select(edgeAB, a, Select(above, b, c));
+		Point4 d3 = Select(above, c, Select(below, b, d));
+		Vector3x4 dir3 = Select(edgeAB, Cross(Cross(ab, AO), ab),
+						 Select(edgeAC, Cross(Cross(ac, AO), ac),
+						 Select(above, n, Negate(n))));
+		__m128i dim3 = _mm_add_epi32(_mm_set1_epi32(3), _mm_castps_si128(_mm_andnot_ps(face, all))); //2 on an edge
+
+		//update_simplex4
+		Vector3x4 ABC = n;
+		Vector3x4 ACD = Cross(ac, ad);
+		Vector3x4 ADB = Cross(ad, ab);
+		__m128 frontABC = _mm_cmpgt_ps(Dot(ABC, AO), zero);
+		__m128 frontACD = _mm_andnot_ps(frontABC, _mm_cmpgt_ps(Dot(ACD, AO), zero));
+		__m128 frontADB = _mm_andnot_ps(_mm_or_ps(frontABC, frontACD), _mm_cmpgt_ps(Dot(ADB, AO), zero));
+		__m128 front	= _mm_or_ps(_mm_or_ps(frontABC, frontACD), frontADB);
+
+		Point4 b4 = Select(front, a, b);
+		Point4 c4 = Select(frontABC, b, Select(frontADB, d, c));
+		Point4 d4 = Select(frontABC, c, Select(frontADB, b, d));
+		Vector3x4 dir4 = Select(frontABC, ABC, Select(frontACD, ACD, Select(frontADB, ADB, search_dir)));
+
+		__m128 nowEnclosed = _mm_andnot_ps(front, is4);
+		enclosed	= _mm_or_ps(enclosed, nowEnclosed);
+		done		= _mm_or_ps(done, nowEnclosed);
+
+		b			= Select(is3, b3, Select(is4, b4, b));
+		c			= Select(is3, c3, Select(is4, c4, c));
+		d			= Select(is3, d3, Select(is4, d4, d));
+		search_dir	= Select(is3, dir3, Select(is4, dir4, search_dir));
+
+		__m128i keep3 = _mm_castps_si128(is3);
+		__m128i keep4 = _mm_castps_si128(is4);
+		simp_dim = _mm_or_si128(_mm_and_si128(keep3, dim3), _mm_andnot_si128(keep3, simp_dim));
+		simp_dim = _mm_or_si128(_mm_and_si128(keep4, _mm_set1_epi32(3)), _mm_andnot_si128(keep4, simp_dim));
+	}
+
+	int separatedLanes	= _mm_movemask_ps(separated);
+	int enclosedLanes	= _mm_movemask_ps(enclosed);
+	for (int lane = 0; lane < 4; ++lane) {
+		status[lane] = (enclosedLanes & (1 << lane)) ? GJK_ENCLOSED : (separatedLanes & (1 << lane)) ? GJK_SEPARATED : GJK_UNDECIDED;
+		StoreLane(search_dir, lane, searchDirs[lane]);
+		StoreLane(a, lane, simplices[lane][0]);
+		StoreLane(b, lane, simplices[lane][1]);
+		StoreLane(c, lane, simplices[lane][2]);
+		StoreLane(d, lane, simplices[lane][3]);
+	}
+}
+
+#else
+
+bool NCL::GJKSimdAvailable()
+{
+	return false;
+}
+
+void NCL::GJKSearch4(const GJKPair* const pairs[4], Vector3 searchDirs[4], Point simplices[4][4], int status[4])
+{
+	for (int lane = 0; lane < 4; ++lane) {
+		status[lane] = GJK_UNDECIDED; //never called, GJKSimdAvailable is false
+	}
+}
+
+#endif
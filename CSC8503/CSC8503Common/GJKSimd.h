@@ -0,0 +1,41 @@
+#pragma once
+#include "GJK.h"
+
+namespace NCL {
+	//Outcome of a GJK search
+	enum GJKStatus {
+		GJK_UNDECIDED,	//ran out of iterations
+		GJK_SEPARATED,	//search direction is a separating axis
+		GJK_ENCLOSED	//simplex encloses the origin
+	};
+
+	//True if the CPU can run the 4 wide kernel and it hasn't been switched off
+	bool GJKSimdAvailable();
+
+	//Switches the 4 wide kernel off, to compare against the scalar path
+	void SetGJKSimdEnabled(bool enabled);
+	bool GetGJKSimdEnabled();
+
+#ifdef _DEBUG
+	//Set at startup and by SetGJKSimdEnabled, until GJKBatch has checked a batch of lanes against the scalar search
+	bool GJKSimdCheckPending();
+	void GJKSimdCheckDone();
+#endif
+
+	/*
+	Whether both shapes of a pair are ones the kernel has support functions for (boxes and
+	spheres). Spheres have a margin though, so while margin mode is on (the default) GJKBatch
+	sends any pair with a sphere to the scalar distance query instead, and only box pairs reach
+	the kernel. The sphere lanes only run with margin mode off.
+	*/
+	bool GJKSimdCanBatch(const GJKPair& pair);
+
+	/*
+	Runs the GJK search on 4 pairs in lockstep, one pair per SSE lane. Lanes that finish
+	early are masked off while the rest carry on. Every lane does exactly the same float
+	operations as the scalar search, so the status, simplex and direction written out are
+	bit for bit what GJKSearch gives for that pair.
+	searchDirs holds each lane's starting direction on entry, and the final one on exit.
+	*/
+	void GJKSearch4(const GJKPair* const pairs[4], Vector3 searchDirs[4], Point simplices[4][4], int status[4]);
+}
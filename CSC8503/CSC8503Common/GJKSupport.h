@@ -0,0 +1,194 @@
+#pragma once
+#include "GJK.h"
+
+namespace NCL {
+	/*
+	Support mappings with the shape known at compile time. Each one is a plain value made
+	from a GJKShape, with the rotation matrices already worked out once for the query.
+	GJK and EPA are templates over the pair type, so a TypedPair gets its own copy of
+	them with every support call inlined, instead of a virtual call that converts the
+	orientation quaternion to a matrix twice.
+
+	The maths is exactly that of each volume's own Support, so typed and untyped queries
+	give the same results.
+	*/
+	struct BoxSupport {
+		static const bool rounded = false;
+
+		Vector3 position;
+		Matrix3 rotation;
+		Matrix3 invRotation;
+		Vector3 halfSizes;
+
+		BoxSupport(const GJKShape& shape) : position(shape.position), rotation(shape.rotation),
+			invRotation(shape.invRotation), halfSizes(shape.halfSizes) {}
+
+		Vector3 Support(const Vector3& dir) const {
+			Vector3 localDir = invRotation * dir;
+			Vector3 result;
+			result.x = (localDir.x > 0) ? halfSizes.x : -halfSizes.x;
+			result.y = (localDir.y > 0) ? halfSizes.y : -halfSizes.y;
+			result.z = (localDir.z > 0) ? halfSizes.z : -halfSizes.z;
+			return rotation * result + position;
+		}
+		Vector3 CoreSupport(const Vector3& dir) const {
+			return Support(dir);
+		}
+		float Margin() const {
+			return 0.0f;
+		}
+	};
+
+	struct SphereSupport {
+		static const bool rounded = true;
+
+		Vector3 position;
+		Matrix3 rotation;	//only for the warm start cache, which stores points in local space
+		Matrix3 invRotation;
+		float	radius;
+
+		SphereSupport(const GJKShape& shape) : position(shape.position), rotation(shape.rotation),
+			invRotation(shape.invRotation), radius(shape.radius) {}
+
+		Vector3 Support(const Vector3& dir) const {
+			return dir.Normalised() * radius + position;
+		}
+		Vector3 CoreSupport(const Vector3&) const {
+			return position;
+		}
+		float Margin() const {
+			return radius;
+		}
+	};
+
+	struct CapsuleSupport {
+		static const bool rounded = true;
+
+		Vector3 position;
+		Matrix3 rotation;
+		Matrix3 invRotation;
+		float	radius;
+		float	halfHeight;
+
+		CapsuleSupport(const GJKShape& shape) : position(shape.position), rotation(shape.rotation),
+			invRotation(shape.invRotation), radius(shape.radius), halfHeight(shape.halfHeight) {}
+
+		Vector3 Support(const Vector3& dir) const {
+			Vector3 localDir = invRotation * dir;
+			Vector3 result = localDir.Normalised() * radius;
+			result.y += (localDir.y > 0) ? halfHeight - radius : -(halfHeight - radius);
+			return rotation * result + position;
+		}
+		Vector3 CoreSupport(const Vector3& dir) const {
+			Vector3 localDir = invRotation * dir;
+			Vector3 result(0, (localDir.y > 0) ? halfHeight - radius : -(halfHeight - radius), 0);
+			return rotation * result + position;
+		}
+		float Margin() const {
+			return radius;
+		}
+	};
+
+	struct CylinderSupport {
+		static const bool rounded = true;
+
+		Vector3 position;
+		Matrix3 rotation;
+		Matrix3 invRotation;
+		float	radius;
+		float	halfHeight;
+		float	margin;
+
+		CylinderSupport(const GJKShape& shape) : position(shape.position), rotation(shape.rotation),
+			invRotation(shape.invRotation), radius(shape.radius), halfHeight(shape.halfHeight), margin(shape.margin) {}
+
+		Vector3 Support(const Vector3& dir) const {
+			Vector3 localDir = invRotation * dir;
+			Vector3 dir_xz = Vector3(localDir.x, 0, localDir.z);
+			Vector3 result = dir_xz.Normalised() * radius;
+			result.y = (localDir.y > 0) ? halfHeight : -halfHeight;
+			return rotation * result + position;
+		}
+		Vector3 CoreSupport(const Vector3& dir) const {
+			Vector3 localDir = invRotation * dir;
+			Vector3 dir_xz = Vector3(localDir.x, 0, localDir.z);
+			Vector3 result = dir_xz.Normalised() * (radius - margin);
+			result.y = (localDir.y > 0) ? halfHeight - margin : -(halfHeight - margin);
+			return rotation * result + position;
+		}
+		float Margin() const {
+			return margin;
+		}
+	};
+
+	//Pair of typed shapes, with the same interface as the pair types GJK.cpp uses for GameObjects and GJKShapes
+	template<class ShapeA, class ShapeB>
+	struct TypedPair {
+		ShapeA a;
+		ShapeB b;
+
+		TypedPair(const ShapeA& a, const ShapeB& b) : a(a), b(b) {}
+
+		Vector3 SupportA(const Vector3& dir) const { return a.Support(dir); }
+		Vector3 SupportB(const Vector3& dir) const { return b.Support(dir); }
+
+		Vector3 CoreSupportA(const Vector3& dir) const { return a.CoreSupport(dir); }
+		Vector3 CoreSupportB(const Vector3& dir) const { return b.CoreSupport(dir); }
+
+		const Vector3& PositionA() const { return a.position; }
+		const Vector3& PositionB() const { return b.position; }
+
+		const Matrix3& RotationA() const	{ return a.rotation; }
+		const Matrix3& RotationB() const	{ return b.rotation; }
+		const Matrix3& InvRotationA() const { return a.invRotation; }
+		const Matrix3& InvRotationB() const { return b.invRotation; }
+
+		float MarginA() const { return a.Margin(); }
+		float MarginB() const { return b.Margin(); }
+
+		bool Rounded() const { return ShapeA::rounded || ShapeB::rounded; }
+	};
+
+	/*
+	Picks the TypedPair for the types of a and b at runtime, and hands it to query.Run,
+	which should be a template so that it's compiled once per combination of shapes.
+	Returns false if either shape has no typed support mapping.
+	*/
+	template<class ShapeA, class Query>
+	bool DispatchTypedShapeB(const ShapeA& a, const GJKShape& b, Query& query) {
+		switch (b.type) {
+			case VolumeType::AABB:
+			case VolumeType::OBB:
+				query.Run(TypedPair<ShapeA, BoxSupport>(a, BoxSupport(b)));
+				return true;
+			case VolumeType::Sphere:
+				query.Run(TypedPair<ShapeA, SphereSupport>(a, SphereSupport(b)));
+				return true;
+			case VolumeType::Capsule:
+				query.Run(TypedPair<ShapeA, CapsuleSupport>(a, CapsuleSupport(b)));
+				return true;
+			case VolumeType::Cylinder:
+				query.Run(TypedPair<ShapeA, CylinderSupport>(a, CylinderSupport(b)));
+				return true;
+			default:
+				return false;
+		}
+	}
+
+	template<class Query>
+	bool DispatchTypedPair(const GJKShape& a, const GJKShape& b, Query& query) {
+		switch (a.type) {
+			case VolumeType::AABB:
+			case VolumeType::OBB:
+				return DispatchTypedShapeB(BoxSupport(a), b, query);
+			case VolumeType::Sphere:
+				return DispatchTypedShapeB(SphereSupport(a), b, query);
+			case VolumeType::Capsule:
+				return DispatchTypedShapeB(CapsuleSupport(a), b, query);
+			case VolumeType::Cylinder:
+				return DispatchTypedShapeB(CylinderSupport(a), b, query);
+			default:
+				return false;
+		}
+	}
+}
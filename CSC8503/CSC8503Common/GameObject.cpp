@@ -21,6 +21,12 @@ GameObject::~GameObject()	{
 	delete renderObject;
 }
 
+//Hulls, compounds and meshes needn't be centred on the object, so the box grows by however far their centre is
+static Vector3 OffCentreBounds(const Matrix3& rotation, const Vector3& localCentre, const Vector3& localHalfSizes) {
+	Vector3 offset = rotation * localCentre;
+	return rotation.Absolute() * localHalfSizes + Vector3(abs(offset.x), abs(offset.y), abs(offset.z));
+}
+
 bool GameObject::GetBroadphaseAABB(Vector3&outSize) const {
 	if (!boundingVolume) {
 		return false;
@@ -41,17 +47,33 @@ void GameObject::UpdateBroadphaseAABB() {
 		broadphaseAABB = Vector3(r, r, r);
 	}
 	else if (boundingVolume->type == VolumeType::OBB) {
-		Matrix3 mat = Matrix3(transform.GetOrientation());
+		Matrix3 mat = transform.GetRotMatrix();
 		mat = mat.Absolute();
 		Vector3 halfSizes = ((OBBVolume&)*boundingVolume).GetHalfDimensions();
 		broadphaseAABB = mat * halfSizes;
 	}
 	else if (boundingVolume->type == VolumeType::Capsule) {
-		Matrix3 mat = Matrix3(transform.GetOrientation());
+		Matrix3 mat = transform.GetRotMatrix();
 		mat = mat.Absolute();
 		float r = ((CapsuleVolume&)*boundingVolume).GetRadius();
 		float halfheight = ((CapsuleVolume&)*boundingVolume).GetHalfHeight();
 		Vector3 halfSizes = Vector3(r, halfheight, r);
 		broadphaseAABB = mat * halfSizes;
 	}
+	else if (boundingVolume->type == VolumeType::Mesh) {
+		const ConvexHullVolume& hull = (ConvexHullVolume&)*boundingVolume;
+		broadphaseAABB = OffCentreBounds(transform.GetRotMatrix(), hull.GetLocalCentre(), hull.GetLocalHalfSizes());
+	}
+	else if (boundingVolume->type == VolumeType::Compound) {
+		const CompoundVolume& compound = (CompoundVolume&)*boundingVolume;
+		broadphaseAABB = OffCentreBounds(transform.GetRotMatrix(), compound.GetLocalCentre(), compound.GetLocalHalfSizes());
+	}
+	else if (boundingVolume->type == VolumeType::TriangleMesh) {
+		const TriangleMeshVolume& mesh = (TriangleMeshVolume&)*boundingVolume;
+		broadphaseAABB = OffCentreBounds(transform.GetRotMatrix(), mesh.GetLocalCentre(), mesh.GetLocalHalfSizes());
+	}
+	else if (boundingVolume->type == VolumeType::Heightfield) {
+		const HeightfieldVolume& heightfield = (HeightfieldVolume&)*boundingVolume;
+		broadphaseAABB = OffCentreBounds(transform.GetRotMatrix(), heightfield.GetLocalCentre(), heightfield.GetLocalHalfSizes());
+	}
 }
\ No newline at end of file
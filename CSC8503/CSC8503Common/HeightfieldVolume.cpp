@@ -0,0 +1,174 @@
+#include "HeightfieldVolume.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cassert>
+
+using namespace NCL;
+
+HeightfieldVolume::HeightfieldVolume(int samplesX, int samplesZ, const std::vector<float>& heights, float cellSize) {
+	type = VolumeType::Heightfield;
+
+	assert(samplesX >= 2 && samplesZ >= 2 && "a heightfield needs at least one cell");
+	assert((int)heights.size() == samplesX * samplesZ && "a heightfield needs a height for every sample");
+
+	//Without asserts, a grid that's too small gets one cell, and missing heights are flat
+	this->samplesX	= std::max(samplesX, 2);
+	this->samplesZ	= std::max(samplesZ, 2);
+	this->cellSize	= cellSize;
+	this->heights	= heights;
+	this->heights.resize(this->samplesX * this->samplesZ, 0.0f);
+
+	halfWidth = (this->samplesX - 1) * cellSize * 0.5f;
+	halfDepth = (this->samplesZ - 1) * cellSize * 0.5f;
+
+	minHeight = *std::min_element(this->heights.begin(), this->heights.end());
+	maxHeight = *std::max_element(this->heights.begin(), this->heights.end());
+}
+
+void HeightfieldVolume::GetTriangle(int i, Vector3* corners) const {
+	int cell	= i / 2;
+	int x		= cell % (samplesX - 1);
+	int z		= cell / (samplesX - 1);
+
+	//Both halves wind counter clockwise seen from above
+	corners[0] = Sample(x, z);
+	if (i % 2 == 0) {
+		corners[1] = Sample(x, z + 1);
+		corners[2] = Sample(x + 1, z + 1);
+	}
+	else {
+		corners[1] = Sample(x + 1, z + 1);
+		corners[2] = Sample(x + 1, z);
+	}
+}
+
+void HeightfieldVolume::GetOverlappingTriangles(const Vector3& boxMin, const Vector3& boxMax, std::vector<int>& overlapping) const {
+	overlapping.clear();
+	if (boxMin.y > maxHeight || boxMax.y < minHeight) {
+		return;
+	}
+	int cellsX = samplesX - 1;
+	int cellsZ = samplesZ - 1;
+
+	int xMin = std::max((int)floor((boxMin.x + halfWidth) / cellSize), 0);
+	int xMax = std::min((int)floor((boxMax.x + halfWidth) / cellSize), cellsX - 1);
+	int zMin = std::max((int)floor((boxMin.z + halfDepth) / cellSize), 0);
+	int zMax = std::min((int)floor((boxMax.z + halfDepth) / cellSize), cellsZ - 1);
+
+	for (int z = zMin; z <= zMax; ++z) {
+		for (int x = xMin; x <= xMax; ++x) {
+			float h00 = heights[z * samplesX + x];
+			float h10 = heights[z * samplesX + x + 1];
+			float h01 = heights[(z + 1) * samplesX + x];
+			float h11 = heights[(z + 1) * samplesX + x + 1];
+			float lo = std::min(std::min(h00, h10), std::min(h01, h11));
+			float hi = std::max(std::max(h00, h10), std::max(h01, h11));
+			if (lo > boxMax.y || hi < boxMin.y) {
+				continue;
+			}
+			int cell = z * cellsX + x;
+			overlapping.push_back(cell * 2);
+			overlapping.push_back(cell * 2 + 1);
+		}
+	}
+}
+
+/*
+The ray is clipped to the heightfield's box, then walked over the grid cell by cell
+(a 2D DDA in xz). Cells are visited in the order the ray passes over them, so the first
+cell with a hit has the nearest one.
+*/
+bool HeightfieldVolume::RayCast(const Vector3& rayPos, const Vector3& rayDir, float maxDistance, float& distance) const {
+	Vector3 boundsMin(-halfWidth, minHeight, -halfDepth);
+	Vector3 boundsMax(halfWidth, maxHeight, halfDepth);
+
+	float tMin = 0.0f;
+	float tMax = maxDistance;
+	for (int axis = 0; axis < 3; ++axis) {
+		if (rayDir.array[axis] == 0.0f) {
+			if (rayPos.array[axis] < boundsMin.array[axis] || rayPos.array[axis] > boundsMax.array[axis]) {
+				return false;
+			}
+			continue;
+		}
+		float t0 = (boundsMin.array[axis] - rayPos.array[axis]) / rayDir.array[axis];
+		float t1 = (boundsMax.array[axis] - rayPos.array[axis]) / rayDir.array[axis];
+		if (t0 > t1) {
+			std::swap(t0, t1);
+		}
+		tMin = std::max(tMin, t0);
+		tMax = std::min(tMax, t1);
+		if (tMin > tMax) {
+			return false;
+		}
+	}
+
+	int cellsX = samplesX - 1;
+	int cellsZ = samplesZ - 1;
+
+	Vector3 start = rayPos + rayDir * tMin;
+	int x = std::min(std::max((int)floor((start.x + halfWidth) / cellSize), 0), cellsX - 1);
+	int z = std::min(std::max((int)floor((start.z + halfDepth) / cellSize), 0), cellsZ - 1);
+
+	int stepX = (rayDir.x > 0) ? 1 : -1;
+	int stepZ = (rayDir.z > 0) ? 1 : -1;
+
+	//Distance along the ray to the next cell edge in x and z, and between edges
+	float nextX		= FLT_MAX;
+	float nextZ		= FLT_MAX;
+	float deltaX	= FLT_MAX;
+	float deltaZ	= FLT_MAX;
+	if (rayDir.x != 0.0f) {
+		float edge = (x + (stepX > 0 ? 1 : 0)) * cellSize - halfWidth;
+		nextX	= (edge - rayPos.x) / rayDir.x;
+		deltaX	= cellSize / fabs(rayDir.x);
+	}
+	if (rayDir.z != 0.0f) {
+		float edge = (z + (stepZ > 0 ? 1 : 0)) * cellSize - halfDepth;
+		nextZ	= (edge - rayPos.z) / rayDir.z;
+		deltaZ	= cellSize / fabs(rayDir.z);
+	}
+
+	float nearest = FLT_MAX;
+	for (;;) {
+		int cell = z * cellsX + x;
+		for (int i = 0; i < 2; ++i) {
+			Vector3 corners[3];
+			GetTriangle(cell * 2 + i, corners);
+			float dist;
+			if (RayTriangleIntersection(rayPos, rayDir, corners, dist) && dist <= tMax) {
+				nearest = std::min(nearest, dist);
+			}
+		}
+		if (nearest < FLT_MAX) {
+			distance = nearest;
+			return true;
+		}
+
+		float cellExit = std::min(nextX, nextZ);
+		if (cellExit > tMax) {
+			return false;
+		}
+		if (nextX < nextZ) {
+			x		+= stepX;
+			nextX	+= deltaX;
+		}
+		else {
+			z		+= stepZ;
+			nextZ	+= deltaZ;
+		}
+		if (x < 0 || x >= cellsX || z < 0 || z >= cellsZ) {
+			return false;
+		}
+	}
+}
+
+Vector3 HeightfieldVolume::Support(const Vector3& dir, const Transform& transform) {
+	Vector3 localDir = transform.GetInvRotMatrix() * dir;
+	Vector3 result(
+		(localDir.x > 0) ? halfWidth : -halfWidth,
+		(localDir.y > 0) ? maxHeight : minHeight,
+		(localDir.z > 0) ? halfDepth : -halfDepth);
+	return transform.GetRotMatrix() * result + transform.GetPosition();
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include "CollisionVolume.h"
+#include "TriangleMeshVolume.h"
+#include "../../Common/Vector3.h"
+#include <vector>
+
+namespace NCL {
+	/*
+	Terrain as a grid of heights. Only the heights are stored, a float per sample, and the
+	two triangles of each cell are made up when they're asked for, so it takes a fraction
+	of the memory of the same terrain as a TriangleMeshVolume.
+
+	The grid lies in the xz plane centred on the object, with samplesX samples along x and
+	samplesZ along z, cellSize apart. Cell (x, z) is split along its diagonal from sample
+	(x, z) to (x + 1, z + 1). Triangle i is in cell i / 2 (counted along x first), and is
+	the half nearer the -x side if i is even.
+	Meant for objects with PhysicsType::Static.
+	*/
+	class HeightfieldVolume : public CollisionVolume
+	{
+	public:
+		//heights[z * samplesX + x] is the height of sample (x, z)
+		HeightfieldVolume(int samplesX, int samplesZ, const std::vector<float>& heights, float cellSize);
+		~HeightfieldVolume() {}
+
+		int GetSamplesX() const {
+			return samplesX;
+		}
+
+		int GetSamplesZ() const {
+			return samplesZ;
+		}
+
+		float GetCellSize() const {
+			return cellSize;
+		}
+
+		//Model space corners of triangle i
+		void GetTriangle(int i, Vector3* corners) const;
+
+		//Triangles of the cells under the box, which is in the heightfield's space. Cells entirely
+		//above or below the box are left out.
+		void GetOverlappingTriangles(const Vector3& boxMin, const Vector3& boxMax, std::vector<int>& overlapping) const;
+
+		//Nearest hit within maxDistance, all in the heightfield's space. The ray steps from
+		//cell to cell under it, so it only tests the cells it passes over.
+		bool RayCast(const Vector3& rayPos, const Vector3& rayDir, float maxDistance, float& distance) const;
+
+		Vector3 GetLocalCentre() const {
+			return Vector3(0, (minHeight + maxHeight) * 0.5f, 0);
+		}
+
+		Vector3 GetLocalHalfSizes() const {
+			return Vector3(halfWidth, (maxHeight - minHeight) * 0.5f, halfDepth);
+		}
+
+		//Support of the heightfield's bounding box. It isn't convex, so this is only good for bounds.
+		Vector3 Support(const Vector3& dir, const Transform& transform);
+
+	protected:
+		Vector3 Sample(int x, int z) const {
+			return Vector3(x * cellSize - halfWidth, heights[z * samplesX + x], z * cellSize - halfDepth);
+		}
+
+		int					samplesX;
+		int					samplesZ;
+		float				cellSize;
+		std::vector<float>	heights;
+
+		float halfWidth;
+		float halfDepth;
+		float minHeight;
+		float maxHeight;
+	};
+}
@@ -0,0 +1,178 @@
+#pragma once
+#include "../../Common/Vector3.h"
+#include "WorkerPool.h"
+#include <vector>
+#include <functional>
+#include <algorithm>
+
+#define LOOSE_OCTREE_NULL -1
+
+namespace NCL {
+	using namespace NCL::Maths;
+	namespace CSC8503 {
+		/*
+		An octree where each node's bounds are loosened to twice the size of its cell, so
+		an object whose centre is in a cell fits in that cell's bounds as long as it's no
+		bigger than the cell. That means every object goes in exactly one node, the
+		smallest one it fits, worked out from its size and which way its centre is from
+		each node's, without ever being split between children like in the QuadTree.
+		Unlike the QuadTree it divides space up and down as well, so stacks of objects
+		are spread over several nodes instead of all landing in one.
+
+		The nodes and entries come from pools that Clear empties without freeing, so
+		filling the tree again every substep doesn't allocate once it's warmed up.
+		*/
+		template<class T>
+		class LooseOctree {
+		public:
+			typedef std::function<void(T, T)> LooseOctreePairFunc;
+
+			//size is half the width of the root cell, which is centred on the origin
+			LooseOctree(float size = 1024.0f, int maxDepth = 8) {
+				this->size		= size;
+				this->maxDepth	= maxDepth;
+				Clear();
+			}
+			~LooseOctree() {
+			}
+
+			void Clear() {
+				nodes.clear();
+				entries.clear();
+				nodes.push_back(MakeNode(Vector3(), size));
+			}
+
+			void Insert(T object, const Vector3& pos, const Vector3& halfSizes) {
+				Entry e;
+				e.object	= object;
+				e.boundsMin = pos - halfSizes;
+				e.boundsMax = pos + halfSizes;
+				int entry = (int)entries.size();
+				entries.push_back(e);
+
+				float radius = (std::max)((std::max)(halfSizes.x, halfSizes.y), halfSizes.z);
+				int node = 0;
+				nodes[node].count++;
+
+				//objects with their centre outside the root cell stay in the root, which is never culled
+				bool inside =	fabs(pos.x) <= size && fabs(pos.y) <= size && fabs(pos.z) <= size;
+				for (int depth = 0; inside && depth < maxDepth && radius <= nodes[node].halfSize * 0.5f; ++depth) {
+					const Vector3& centre = nodes[node].centre;
+					int octant = (pos.x > centre.x ? 1 : 0) | (pos.y > centre.y ? 2 : 0) | (pos.z > centre.z ? 4 : 0);
+					node = GetChild(node, octant);
+					nodes[node].count++;
+				}
+				entries[entry].next		= nodes[node].firstEntry;
+				nodes[node].firstEntry	= entry;
+			}
+
+			/*
+			Calls func once for each pair of objects whose boxes overlap. Each object looks
+			down the tree through the nodes whose loose bounds its box touches, and only
+			takes the objects put in after it, so no pair is found twice.
+			*/
+			void OperateOnPairs(LooseOctreePairFunc func) {
+				for (int i = 0; i < (int)entries.size(); ++i) {
+					QueryEntry(i, nodeStack, func);
+				}
+			}
+
+			//Adds the same pairs as OperateOnPairs to pairs, with the entries split up between the pool's threads
+			void FindPairs(WorkerPool& pool, std::vector<std::pair<T, T>>& pairs) {
+				if ((int)jobStacks.size() < pool.GetNumJobs()) {
+					jobStacks.resize(pool.GetNumJobs());
+				}
+				pool.RunRanges((int)entries.size(), jobPairs, pairs,
+					[&](int job, int first, int last, std::vector<std::pair<T, T>>& out) {
+						for (int i = first; i < last; ++i) {
+							QueryEntry(i, jobStacks[job], [&](T a, T b) { out.push_back(std::make_pair(a, b)); });
+						}
+					});
+			}
+
+		protected:
+			struct Node {
+				Vector3 centre;
+				float	halfSize;	//of the cell, the loose bounds are twice this
+				int		firstChild;	//children are 8 nodes in a row, octant bit 0 is +x, bit 1 +y and bit 2 +z
+				int		firstEntry;
+				int		count;		//objects in this node and everything under it
+			};
+
+			struct Entry {
+				T		object;
+				Vector3 boundsMin;
+				Vector3 boundsMax;
+				int		next;	//next entry in the same node
+			};
+
+			static Node MakeNode(const Vector3& centre, float halfSize) {
+				Node n;
+				n.centre		= centre;
+				n.halfSize		= halfSize;
+				n.firstChild	= LOOSE_OCTREE_NULL;
+				n.firstEntry	= LOOSE_OCTREE_NULL;
+				n.count			= 0;
+				return n;
+			}
+
+			template<class PairFunc>
+			void QueryEntry(int i, std::vector<int>& stack, const PairFunc& func) const {
+				const Entry& a = entries[i];
+				stack.clear();
+				stack.push_back(0);
+				while (!stack.empty()) {
+					const Node& n = nodes[stack.back()];
+					bool isRoot = stack.back() == 0;
+					stack.pop_back();
+					if (n.count == 0) {
+						continue;
+					}
+					if (!isRoot) {
+						float loose = n.halfSize * 2.0f;
+						if (a.boundsMin.x > n.centre.x + loose || a.boundsMax.x < n.centre.x - loose ||
+							a.boundsMin.y > n.centre.y + loose || a.boundsMax.y < n.centre.y - loose ||
+							a.boundsMin.z > n.centre.z + loose || a.boundsMax.z < n.centre.z - loose) {
+							continue;
+						}
+					}
+					for (int j = n.firstEntry; j != LOOSE_OCTREE_NULL; j = entries[j].next) {
+						const Entry& b = entries[j];
+						if (j > i &&
+							a.boundsMin.x <= b.boundsMax.x && a.boundsMax.x >= b.boundsMin.x &&
+							a.boundsMin.y <= b.boundsMax.y && a.boundsMax.y >= b.boundsMin.y &&
+							a.boundsMin.z <= b.boundsMax.z && a.boundsMax.z >= b.boundsMin.z) {
+							func(a.object, b.object);
+						}
+					}
+					if (n.firstChild != LOOSE_OCTREE_NULL) {
+						for (int c = 0; c < 8; ++c) {
+							stack.push_back(n.firstChild + c);
+						}
+					}
+				}
+			}
+
+			int GetChild(int node, int octant) {
+				if (nodes[node].firstChild == LOOSE_OCTREE_NULL) {
+					Vector3 centre	= nodes[node].centre;
+					float	half	= nodes[node].halfSize * 0.5f;
+					nodes[node].firstChild = (int)nodes.size();
+					for (int i = 0; i < 8; ++i) { //can reallocate nodes, so nothing is held by reference over this
+						Vector3 offset((i & 1) ? half : -half, (i & 2) ? half : -half, (i & 4) ? half : -half);
+						nodes.push_back(MakeNode(centre + offset, half));
+					}
+				}
+				return nodes[node].firstChild + octant;
+			}
+
+			std::vector<Node>	nodes;	//nodes[0] is the root
+			std::vector<Entry>	entries;
+			std::vector<int>	nodeStack;
+			std::vector<std::vector<std::pair<T, T>>>	jobPairs;	//one per job, for FindPairs
+			std::vector<std::vector<int>>				jobStacks;	//and a nodeStack for each job
+			float				size;
+			int					maxDepth;
+		};
+	}
+}
@@ -40,6 +40,10 @@ namespace NCL {
 			//CollisionDetection::RayOBBIntersection(r, transform, *this, collision);
 			//return collision.collidedAt;
 		}
+
+		int GetFeature(const Vector3& dir, const Transform& transform, Vector3* points) {
+			return GetBoxFeature(halfSizes, dir, transform, points);
+		}
 	protected:
 		Maths::Vector3 halfSizes;
 	};
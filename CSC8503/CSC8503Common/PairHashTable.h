@@ -0,0 +1,134 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+
+#define PAIR_TABLE_EMPTY -1
+#define PAIR_TABLE_MIN_SLOTS 64
+
+namespace NCL {
+	namespace CSC8503 {
+		/*
+		Values keyed by a pair of worldIDs packed into a uint64_t (see PhysicsSystem's PairKey).
+		The values are kept in one contiguous array, in the order they went in, and an open
+		addressing table with linear probing maps keys to where they are in it. Adding a
+		value doesn't allocate unless the table has to grow, and Clear keeps all the memory,
+		so a table that's filled again every substep settles down to no allocations at all.
+		Removing moves the last value into the gap, so indices aren't stable over a Remove.
+		*/
+		template<class V>
+		class PairHashTable {
+		public:
+			PairHashTable() {
+				slots.assign(PAIR_TABLE_MIN_SLOTS, PAIR_TABLE_EMPTY);
+			}
+			~PairHashTable() {
+			}
+
+			void Clear() {
+				if (!keys.empty()) {
+					std::fill(slots.begin(), slots.end(), PAIR_TABLE_EMPTY);
+				}
+				keys.clear();
+				values.clear();
+			}
+
+			int Size() const {
+				return (int)values.size();
+			}
+
+			V& operator[](int i) {
+				return values[i];
+			}
+
+			const V& operator[](int i) const {
+				return values[i];
+			}
+
+			uint64_t GetKey(int i) const {
+				return keys[i];
+			}
+
+			V* Find(uint64_t key) {
+				int slot = FindSlot(key);
+				return slots[slot] == PAIR_TABLE_EMPTY ? nullptr : &values[slots[slot]];
+			}
+
+			//The value for key, which is default constructed if it's new, in which case added is set
+			V& Insert(uint64_t key, bool& added) {
+				if ((keys.size() + 1) * 2 > slots.size()) {
+					Grow(); //kept at most half full, so the probe runs stay short
+				}
+				int slot = FindSlot(key);
+				added = slots[slot] == PAIR_TABLE_EMPTY;
+				if (added) {
+					slots[slot] = (int)values.size();
+					keys.push_back(key);
+					values.push_back(V());
+				}
+				return values[slots[slot]];
+			}
+
+			void Remove(uint64_t key) {
+				int slot = FindSlot(key);
+				int index = slots[slot];
+				if (index == PAIR_TABLE_EMPTY) {
+					return;
+				}
+				//Later keys in the same probe run are shuffled back, so none of them are cut off from their home slot
+				size_t mask = slots.size() - 1;
+				size_t hole = slot;
+				size_t next = hole;
+				slots[hole] = PAIR_TABLE_EMPTY;
+				for (;;) {
+					next = (next + 1) & mask;
+					if (slots[next] == PAIR_TABLE_EMPTY) {
+						break;
+					}
+					size_t home = Hash(keys[slots[next]]) & mask;
+					if (((next - home) & mask) >= ((next - hole) & mask)) {
+						slots[hole] = slots[next];
+						slots[next] = PAIR_TABLE_EMPTY;
+						hole = next;
+					}
+				}
+				//and the last value fills the gap in the array
+				int last = (int)values.size() - 1;
+				if (index != last) {
+					slots[FindSlot(keys[last])] = index;
+					keys[index]		= keys[last];
+					values[index]	= values[last];
+				}
+				keys.pop_back();
+				values.pop_back();
+			}
+
+		protected:
+			static size_t Hash(uint64_t key) {
+				uint64_t h = key * 0x9E3779B97F4A7C15ull; //Fibonacci hashing, the top bits are the well mixed ones
+				return (size_t)(h ^ (h >> 32));
+			}
+
+			//Where key is, or the empty slot it would go in
+			int FindSlot(uint64_t key) const {
+				size_t mask = slots.size() - 1;
+				size_t slot = Hash(key) & mask;
+				while (slots[slot] != PAIR_TABLE_EMPTY && keys[slots[slot]] != key) {
+					slot = (slot + 1) & mask;
+				}
+				return (int)slot;
+			}
+
+			void Grow() {
+				slots.assign(slots.size() * 2, PAIR_TABLE_EMPTY);
+				for (int i = 0; i < (int)keys.size(); ++i) {
+					slots[FindSlot(keys[i])] = i;
+				}
+			}
+
+			std::vector<int>		slots;	//index into keys and values, size is a power of two
+			std::vector<uint64_t>	keys;
+			std::vector<V>			values;
+		};
+	}
+}
@@ -52,9 +52,12 @@ void PhysicsObject::ClearForces() {
 }
 
 void PhysicsObject::InitCubeInertia() {
-	Vector3 dimensions	= transform->GetScale();
+	InitCubeInertia(transform->GetScale());
+}
 
-	Vector3 fullWidth = dimensions * 2;
+//For anything that's roughly box shaped but isn't sized by its scale, like a convex hull
+void PhysicsObject::InitCubeInertia(const Vector3& halfSizes) {
+	Vector3 fullWidth = halfSizes * 2;
 
 	Vector3 dimsSqr		= fullWidth * fullWidth;
 
@@ -71,10 +74,8 @@ void PhysicsObject::InitSphereInertia() {
 }
 
 void PhysicsObject::UpdateInertiaTensor() {
-	Quaternion q = transform->GetOrientation();
-	
-	Matrix3 invOrientation	= Matrix3(q.Conjugate());
-	Matrix3 orientation		= Matrix3(q);
+	const Matrix3& invOrientation	= transform->GetInvRotMatrix();
+	const Matrix3& orientation		= transform->GetRotMatrix();
 
 	inverseInteriaTensor = orientation * Matrix3::Scale(inverseInertia) *invOrientation;
 }
\ No newline at end of file
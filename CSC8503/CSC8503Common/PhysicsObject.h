@@ -70,6 +70,7 @@ namespace NCL {
 			}
 
 			void InitCubeInertia();
+			void InitCubeInertia(const Vector3& halfSizes);
 			void InitSphereInertia();
 
 			void UpdateInertiaTensor();
@@ -13,6 +13,7 @@
 #include "../GameTech/TutorialGame.h"
 
 #include "GJK.h"
+#include "GJKSimd.h"
 
 using namespace NCL;
 using namespace CSC8503;
@@ -24,7 +25,7 @@ and the forces that are added to objects to change those positions
 
 */
 
-PhysicsSystem::PhysicsSystem(GameWorld& g) : gameWorld(g)	{
+PhysicsSystem::PhysicsSystem(GameWorld& g) : gameWorld(g), quadTree(Vector2(1024, 1024), 7, 6)	{
 	applyGravity	= false;
 	useBroadPhase	= false;	
 	dTOffset		= 0.0f;
@@ -56,7 +57,14 @@ any collisions they are in.
 
 */
 void PhysicsSystem::Clear() {
-	allBroadPhaseCollisions.clear();
+	broadPhasePairs.Clear();
+	persistentContacts.Clear();
+	gjkCaches.clear();
+	contactManifolds.clear();
+	dynamicTree.Clear();
+	treeProxies.Clear();
+	sweepAndPrune.Clear();
+	sweepProxies.Clear();
 }
 
 /*
@@ -88,6 +96,27 @@ void PhysicsSystem::Update(float dt) {
 			InitBroadPhase();
 		}
 	}
+	if (Window::GetKeyboard()->KeyPressed(KeyboardKeys::V)) {
+		broadPhaseType = (BroadPhaseType)(((int)broadPhaseType + 1) % (int)BroadPhaseType::MAX);
+		std::cout << "Setting broadphase type to " << (int)broadPhaseType << std::endl;
+	}
+	if (Window::GetKeyboard()->KeyPressed(KeyboardKeys::P)) {
+		parallelBroadPhase = !parallelBroadPhase;
+		std::cout << "Setting parallel broadphase to " << parallelBroadPhase << " (" << broadPhaseWorkers.GetNumThreads() << " threads)" << std::endl;
+	}
+	if (Window::GetKeyboard()->KeyPressed(KeyboardKeys::M)) {
+		usePersistentManifolds = !usePersistentManifolds;
+		contactManifolds.clear();
+		std::cout << "Setting persistent manifolds to " << usePersistentManifolds << std::endl;
+	}
+	if (Window::GetKeyboard()->KeyPressed(KeyboardKeys::N)) {
+		SetGJKMarginMode(!GetGJKMarginMode());
+		std::cout << "Setting GJK margin mode to " << GetGJKMarginMode() << std::endl;
+	}
+	if (Window::GetKeyboard()->KeyPressed(KeyboardKeys::U)) {
+		SetGJKSimdEnabled(!GetGJKSimdEnabled());
+		std::cout << "Setting GJK SIMD to " << GetGJKSimdEnabled() << " (available " << GJKSimdAvailable() << ")" << std::endl;
+	}
 	if (Window::GetKeyboard()->KeyPressed(KeyboardKeys::I)) {
 		constraintIterationCount--;
 
@@ -135,6 +164,10 @@ void PhysicsSystem::Update(float dt) {
 
 	UpdateCollisionList(); //Remove any old collisions
 
+	UpdateGJKCaches(); //Remove any old warm start data
+
+	UpdateContactManifolds();
+
 	t.Tick();
 	float updateTime = t.GetTimeDeltaSeconds();
 
@@ -170,7 +203,7 @@ void NCL::CSC8503::PhysicsSystem::TestUpdate(float dt)
 
 /*
 Later on we're going to need to keep track of collisions
-across multiple frames, so we store them in a set.
+across multiple frames, so we store them in a table keyed by the pair.
 
 The first time they are added, we tell the objects they are colliding.
 The frame they are to be removed, we tell them they're no longer colliding.
@@ -179,19 +212,107 @@ From this simple mechanism, we we build up gameplay interactions inside the
 OnCollisionBegin / OnCollisionEnd functions (removing health when hit by a 
 rocket launcher, gaining a point when the player hits the gold coin, and so on).
 */
+//The pair's worldIDs packed together, the key for all the per pair tables
+static uint64_t PairKey(const GameObject* a, const GameObject* b) {
+	return (uint64_t)(uint32_t)a->GetWorldID() | ((uint64_t)(uint32_t)b->GetWorldID() << 32); //64 bits on Win32 too, or the IDs would overlap
+}
+
 void PhysicsSystem::UpdateCollisionList() {
-	for (std::set<CollisionDetection::CollisionInfo>::iterator i = allBroadPhaseCollisions.begin(); i != allBroadPhaseCollisions.end(); ) {
-		if ((*i).framesLeft == numCollisionFrames) {
-			i->a->OnCollisionBegin(i->b);
-			i->b->OnCollisionBegin(i->a);
-		}
-		(*i).framesLeft = (*i).framesLeft - 1;
-		if ((*i).framesLeft < 0) {
-			if (i->a && i->b) {
-				i->a->OnCollisionEnd(i->b);
-				i->b->OnCollisionEnd(i->a);
-			}
-			i = allBroadPhaseCollisions.erase(i);
+	for (int i = 0; i < persistentContacts.Size(); ) {
+		PersistentContact& contact = persistentContacts[i];
+		CollisionDetection::CollisionInfo& info = contact.info;
+		if (!contact.begun) {
+			info.a->OnCollisionBegin(info.b);
+			info.b->OnCollisionBegin(info.a);
+			contact.begun = true;
+		}
+		info.framesLeft--;
+		if (info.framesLeft < 0) {
+			info.a->OnCollisionEnd(info.b);
+			info.b->OnCollisionEnd(info.a);
+			persistentContacts.Remove(persistentContacts.GetKey(i)); //the last contact moves into this slot
+		}
+		else {
+			++i;
+		}
+	}
+}
+
+//Pairs still touching keep their entry, and only have their countdown started again
+void PhysicsSystem::AddPersistentContact(const CollisionDetection::CollisionInfo& info) {
+	bool added;
+	PersistentContact& contact = persistentContacts.Insert(PairKey(info.a, info.b), added);
+	contact.info			= info;
+	contact.info.framesLeft = numCollisionFrames;
+}
+
+/*
+GJK keeps a little state per pair between substeps, so that resting pairs
+can reuse last substep's simplex. Pairs that haven't been queried for a few
+frames are no longer touching anything, so their entries are dropped.
+*/
+GJKCache* PhysicsSystem::GetGJKCache(GameObject* a, GameObject* b) {
+	GJKCache& cache = gjkCaches[PairKey(a, b)];
+	cache.framesUnused = 0;
+	return &cache;
+}
+
+void PhysicsSystem::UpdateGJKCaches() {
+	for (auto i = gjkCaches.begin(); i != gjkCaches.end(); ) {
+		if (++i->second.framesUnused > numCollisionFrames) {
+			i = gjkCaches.erase(i);
+		}
+		else {
+			++i;
+		}
+	}
+}
+
+/*
+Pairs of volumes with a closed form test registered in CollisionDetection's
+dispatch table use that, everything else goes through GJK + EPA.
+*/
+bool PhysicsSystem::PairIntersection(GameObject* a, GameObject* b, CollisionDetection::CollisionInfo& info) {
+	CollisionDetection::PairTest test = CollisionDetection::GetPairTest(a->GetBoundingVolume()->type, b->GetBoundingVolume()->type);
+	if (!test) {
+		return GJKCalculation(a, b, info, GetGJKCache(a, b));
+	}
+	info.a = a;
+	info.b = b;
+	info.ClearContactPoints();
+	return test(a, b, info);
+}
+
+//Compounds, triangle meshes and heightfields give a contact for each child or triangle that's touching, which is a manifold already
+static bool HasOwnManifold(const GameObject* object) {
+	VolumeType type = object->GetBoundingVolume()->type;
+	return type == VolumeType::Compound || type == VolumeType::TriangleMesh || type == VolumeType::Heightfield;
+}
+
+/*
+Turns the single EPA contact in info into a manifold. Either the features are
+clipped against each other straight away, or the contact is added to a
+manifold that has been built up over the last few frames, which is cheaper
+but needs a few frames to fill in after objects first touch.
+*/
+void PhysicsSystem::GenerateContacts(CollisionDetection::CollisionInfo& info) {
+	if (HasOwnManifold(info.a) || HasOwnManifold(info.b)) {
+		return;
+	}
+	if (!usePersistentManifolds) {
+		BuildContactManifold(info.a, info.b, info);
+		return;
+	}
+	ContactManifold& manifold = contactManifolds[PairKey(info.a, info.b)];
+	manifold.framesUnused = 0;
+	manifold.Update(info.a, info.b, info.point);
+	manifold.GetContacts(info);
+}
+
+void PhysicsSystem::UpdateContactManifolds() {
+	for (auto i = contactManifolds.begin(); i != contactManifolds.end(); ) {
+		if (++i->second.framesUnused > numCollisionFrames) {
+			i = contactManifolds.erase(i);
 		}
 		else {
 			++i;
@@ -214,9 +335,9 @@ void PhysicsSystem::UpdateObjectAABBs() {
 This is how we'll be doing collision detection in tutorial 4.
 We step through every pair of objects once (the inner for loop offset 
 ensures this), and determine whether they collide, and if so, add them
-to the collision set for later processing. The set will guarantee that
+to the contact table for later processing. The table will guarantee that
 a particular pair will only be added once, so objects colliding for
-multiple frames won't flood the set with duplicates.
+multiple frames won't flood the table with duplicates.
 */
 void PhysicsSystem::BasicCollisionDetection() {
 	std::vector < GameObject* >::const_iterator first;
@@ -239,7 +360,8 @@ void PhysicsSystem::BasicCollisionDetection() {
 			CollisionDetection::CollisionInfo info;
 			/*if (CollisionDetection::ObjectIntersection(*i, *j, info)) {*/
 	
-			if (GJKCalculation(*i, *j, info)) {
+			if (PairIntersection(*i, *j, info)) {
+				GenerateContacts(info);
 				if (gameWorld.DebugMode()) {
 					std::cout << " Collision between " << (*i)->GetName()
 						<< " and " << (*j)->GetName() << std::endl;
@@ -280,12 +402,11 @@ void PhysicsSystem::BasicCollisionDetection() {
 				//	tutorialGame->AddDebugPoint(info.point.localA);
 				/*Test*/
 				if (bPhysics) {
-					ImpulseResolveCollision(*info.a, *info.b, info.point);
+					ImpulseResolveCollision(*info.a, *info.b, info);
 				}
 				/*Test*/
 
-				info.framesLeft = numCollisionFrames;
-				allBroadPhaseCollisions.insert(info);
+				AddPersistentContact(info);
 			}
 		}
 	}
@@ -357,6 +478,76 @@ void PhysicsSystem::ImpulseResolveCollision(GameObject& a, GameObject& b, Collis
 	physB -> ApplyAngularImpulse(Vector3::Cross(relativeB, fullImpulse));
 }
 
+/*
+Manifold version of the above. The objects are only pushed apart once, by the
+deepest contact, as every contact shares the same normal. Impulses are then
+applied one contact at a time, each one seeing the velocities left by the ones
+before it, so a box resting on a face gets its weight spread over all 4 corners
+instead of being tipped around a single point.
+*/
+void PhysicsSystem::ImpulseResolveCollision(GameObject& a, GameObject& b, CollisionDetection::CollisionInfo& info) const {
+	if (info.numContacts <= 1) {
+		ImpulseResolveCollision(a, b, info.point);
+		return;
+	}
+	PhysicsObject* physA = a.GetPhysicsObject();
+	PhysicsObject* physB = b.GetPhysicsObject();
+
+	Transform& transformA = a.GetTransform();
+	Transform& transformB = b.GetTransform();
+
+	float totalMass = physA->GetInverseMass() + physB->GetInverseMass();
+
+	if (totalMass == 0) {
+		return;
+	}
+
+	const CollisionDetection::ContactPoint& p = info.point;
+	transformA.SetPosition(transformA.GetPosition() -
+		(p.normal * p.penetration * (physA->GetInverseMass() / totalMass)));
+
+	transformB.SetPosition(transformB.GetPosition() +
+		(p.normal * p.penetration * (physB->GetInverseMass() / totalMass)));
+
+	for (int i = 0; i < info.numContacts; ++i) {
+		ApplyContactImpulse(*physA, *physB, info.contacts[i]);
+	}
+}
+
+void PhysicsSystem::ApplyContactImpulse(PhysicsObject& physA, PhysicsObject& physB, const CollisionDetection::ContactPoint& p) const {
+	float totalMass = physA.GetInverseMass() + physB.GetInverseMass();
+
+	Vector3 relativeA = p.localA;
+	Vector3 relativeB = p.localB;
+
+	Vector3 fullVelocityA = physA.GetLinearVelocity() + Vector3::Cross(physA.GetAngularVelocity(), relativeA);
+	Vector3 fullVelocityB = physB.GetLinearVelocity() + Vector3::Cross(physB.GetAngularVelocity(), relativeB);
+
+	float impulseForce = Vector3::Dot(fullVelocityB - fullVelocityA, p.normal);
+	if (impulseForce > 0) {
+		return; //already separating at this contact, an earlier one dealt with it
+	}
+
+	Vector3 inertiaA = Vector3::Cross(physA.GetInertiaTensor() *
+		Vector3::Cross(relativeA, p.normal), relativeA);
+	Vector3 inertiaB = Vector3::Cross(physB.GetInertiaTensor() *
+		Vector3::Cross(relativeB, p.normal), relativeB);
+	float angularEffect = Vector3::Dot(inertiaA + inertiaB, p.normal);
+
+	float cRestitution = physA.GetElasticity() * physB.GetElasticity();
+
+	float j = (-(1.0f + cRestitution) * impulseForce) /
+		(totalMass + angularEffect);
+
+	Vector3 fullImpulse = p.normal * j;
+
+	physA.ApplyLinearImpulse(-fullImpulse);
+	physB.ApplyLinearImpulse(fullImpulse);
+
+	physA.ApplyAngularImpulse(Vector3::Cross(relativeA, -fullImpulse));
+	physB.ApplyAngularImpulse(Vector3::Cross(relativeB, fullImpulse));
+}
+
 
 
 /*
@@ -369,8 +560,35 @@ compare the collisions that we absolutely need to.
 */
 
 void PhysicsSystem::BroadPhase() {
-	allBroadPhaseCollisions.clear();
-	QuadTree <GameObject*> tree(Vector2(1024, 1024), 7, 6);
+	broadPhasePairs.Clear();
+	switch (broadPhaseType) {
+		case BroadPhaseType::QuadTree:		QuadTreeBroadPhase(); break;
+		case BroadPhaseType::DynamicTree:	DynamicTreeBroadPhase(); break;
+		case BroadPhaseType::SweepAndPrune:	SweepAndPruneBroadPhase(); break;
+		case BroadPhaseType::SpatialHash:	SpatialHashBroadPhase(); break;
+		case BroadPhaseType::LooseOctree:	LooseOctreeBroadPhase(); break;
+		default:							break;
+	}
+}
+
+void PhysicsSystem::AddBroadPhasePair(GameObject* a, GameObject* b) {
+	if (a->GetPhysicsObject()->GetPhysicsType() == PhysicsType::Static && b->GetPhysicsObject()->GetPhysicsType() == PhysicsType::Static) {
+		return;
+	}
+	GameObject* lower	= min(a, b); //compare the numerical value of pointers
+	GameObject* higher	= max(a, b);
+
+	//the same pair can turn up more than once, in more than one quadtree node etc
+	bool added;
+	CollisionDetection::CollisionInfo& info = broadPhasePairs.Insert(PairKey(lower, higher), added);
+	if (added) {
+		info.a = lower;
+		info.b = higher;
+	}
+}
+
+void PhysicsSystem::QuadTreeBroadPhase() {
+	quadTree.Clear();
 
 	std::vector <GameObject*>::const_iterator first;
 	std::vector <GameObject*>::const_iterator last;
@@ -381,45 +599,256 @@ void PhysicsSystem::BroadPhase() {
 			continue;
 		}
 		Vector3 pos = (*i)->GetTransform().GetPosition();
-		tree.Insert(*i, pos, halfSizes);
+		quadTree.Insert(*i, pos, halfSizes);
 	}
 
-	tree.OperateOnContents(
-		[&](std::list < QuadTreeEntry <GameObject*> >& data) {
-			CollisionDetection::CollisionInfo info;
+	if (UseParallelBroadPhase()) {
+		quadTree.FindPairs(broadPhaseWorkers, broadPhaseCandidates);
+		AddBroadPhaseCandidates();
+		return;
+	}
+	quadTree.OperateOnContents(
+		[&](std::vector < QuadTreeEntry <GameObject*> >& data) {
 			for (auto i = data.begin(); i != data.end(); ++i) {
 				for (auto j = std::next(i); j != data.end(); ++j) {
-					
-					if ((*i).object->GetPhysicsObject()->GetPhysicsType() == PhysicsType::Static && (*j).object->GetPhysicsObject()->GetPhysicsType() == PhysicsType::Static) {
-						continue;
-					}
-					// is this pair of items already in the collision set -
-					// if the same pair is in another quadtree node together etc
-					info.a = min((*i).object, (*j).object); //compare the numerical value of pointers
-					info.b = max((*i).object, (*j).object);
-					allBroadPhaseCollisions.insert(info);
+					AddBroadPhasePair((*i).object, (*j).object);
 				}
 			}
 		});
 }
 
+/*
+Whether the broadphases should find their pairs over all the broadPhaseWorkers. Each
+worker writes the pairs it finds into a buffer of its own, and the buffers are joined up
+into broadPhaseCandidates, which AddBroadPhaseCandidates then puts through the pair table
+to get rid of any pair found more than once.
+*/
+bool PhysicsSystem::UseParallelBroadPhase() const {
+	if (!parallelBroadPhase || broadPhaseWorkers.GetNumThreads() < 2) {
+		return false;
+	}
+	std::vector <GameObject*>::const_iterator first;
+	std::vector <GameObject*>::const_iterator last;
+	gameWorld.GetObjectIterators(first, last);
+	return last - first >= parallelBroadPhaseMinObjects;
+}
+
+void PhysicsSystem::AddBroadPhaseCandidates() {
+	for (const std::pair<GameObject*, GameObject*>& p : broadPhaseCandidates) {
+		AddBroadPhasePair(p.first, p.second);
+	}
+	broadPhaseCandidates.clear();
+}
+
+/*
+The persistent broadphases are kept between substeps, so here objects are only moved in
+them, and new ones inserted. Objects that have left the world since the last substep are
+found by their worldID not having been seen this time, and are removed.
+*/
+template<class BroadPhaseStructure>
+static void SyncBroadPhase(const GameWorld& world, BroadPhaseStructure& structure, BroadPhaseProxies& proxies, int step) {
+	std::vector <GameObject*>::const_iterator first;
+	std::vector <GameObject*>::const_iterator last;
+	world.GetObjectIterators(first, last);
+	for (auto i = first; i != last; ++i) {
+		Vector3 halfSizes;
+		if (!(*i)->GetBroadphaseAABB(halfSizes)) {
+			continue;
+		}
+		Vector3 pos = (*i)->GetTransform().GetPosition();
+		int id = (*i)->GetWorldID();
+		if (id >= (int)proxies.proxies.size()) {
+			proxies.proxies.resize(id + 1, -1);
+			proxies.steps.resize(id + 1, 0);
+		}
+		int& proxy = proxies.proxies[id];
+		if (proxy >= 0 && structure.GetObject(proxy) != *i) {
+			structure.Remove(proxy); //the world was cleared and the ID given to a new object
+			proxy = -1;
+		}
+		if (proxy < 0) {
+			proxy = structure.Insert(*i, pos, halfSizes);
+		}
+		else {
+			structure.Move(proxy, pos, halfSizes);
+		}
+		proxies.steps[id] = step;
+	}
+	for (int id = 0; id < (int)proxies.proxies.size(); ++id) {
+		if (proxies.proxies[id] >= 0 && proxies.steps[id] != step) {
+			structure.Remove(proxies.proxies[id]);
+			proxies.proxies[id] = -1;
+		}
+	}
+}
+
+void PhysicsSystem::DynamicTreeBroadPhase() {
+	SyncBroadPhase(gameWorld, dynamicTree, treeProxies, ++broadPhaseStep);
+
+	if (UseParallelBroadPhase()) {
+		dynamicTree.FindPairs(broadPhaseWorkers, broadPhaseCandidates);
+		AddBroadPhaseCandidates();
+		return;
+	}
+	dynamicTree.OperateOnPairs(
+		[&](GameObject* a, GameObject* b) {
+			AddBroadPhasePair(a, b);
+		});
+}
+
+/*
+As well as the pairs, the sweep says which pairs have stopped overlapping, so their
+warm start data can go straight away rather than waiting for it to time out.
+*/
+void PhysicsSystem::SweepAndPruneBroadPhase() {
+	SyncBroadPhase(gameWorld, sweepAndPrune, sweepProxies, ++broadPhaseStep);
+	if (UseParallelBroadPhase()) {
+		sweepAndPrune.UpdatePairs(broadPhaseWorkers);
+	}
+	else {
+		sweepAndPrune.UpdatePairs();
+	}
+
+	sweepAndPrune.OperateOnPairs(
+		[&](GameObject* a, GameObject* b) {
+			AddBroadPhasePair(a, b);
+		});
+	sweepAndPrune.OperateOnRemovedPairs(
+		[&](GameObject* a, GameObject* b) {
+			uint64_t key = PairKey(min(a, b), max(a, b));
+			gjkCaches.erase(key);
+			contactManifolds.erase(key);
+		});
+}
+
+void PhysicsSystem::SpatialHashBroadPhase() {
+	spatialHash.Clear();
+
+	std::vector <GameObject*>::const_iterator first;
+	std::vector <GameObject*>::const_iterator last;
+	gameWorld.GetObjectIterators(first, last);
+	for (auto i = first; i != last; ++i) {
+		Vector3 halfSizes;
+		if (!(*i)->GetBroadphaseAABB(halfSizes)) {
+			continue;
+		}
+		spatialHash.Insert(*i, (*i)->GetTransform().GetPosition(), halfSizes);
+	}
+
+	if (UseParallelBroadPhase()) {
+		spatialHash.FindPairs(broadPhaseWorkers, broadPhaseCandidates);
+	}
+	else {
+		spatialHash.FindPairs(broadPhaseCandidates);
+	}
+	AddBroadPhaseCandidates();
+}
+
+void PhysicsSystem::LooseOctreeBroadPhase() {
+	looseOctree.Clear();
+
+	std::vector <GameObject*>::const_iterator first;
+	std::vector <GameObject*>::const_iterator last;
+	gameWorld.GetObjectIterators(first, last);
+	for (auto i = first; i != last; ++i) {
+		Vector3 halfSizes;
+		if (!(*i)->GetBroadphaseAABB(halfSizes)) {
+			continue;
+		}
+		looseOctree.Insert(*i, (*i)->GetTransform().GetPosition(), halfSizes);
+	}
+
+	if (UseParallelBroadPhase()) {
+		looseOctree.FindPairs(broadPhaseWorkers, broadPhaseCandidates);
+		AddBroadPhaseCandidates();
+		return;
+	}
+	looseOctree.OperateOnPairs(
+		[&](GameObject* a, GameObject* b) {
+			AddBroadPhasePair(a, b);
+		});
+}
+
 /*
 
 The broadphase will now only give us likely collisions, so we can now go through them,
 and work out if they are truly colliding, and if so, add them into the main collision list
 */
 void PhysicsSystem::NarrowPhase() {
-	for (std::set < CollisionDetection::CollisionInfo >::iterator
-		 i = allBroadPhaseCollisions.begin();
-		 i != allBroadPhaseCollisions.end(); ++i) {
-		 CollisionDetection::CollisionInfo info = *i;
-		if (GJKCalculation(info.a, info.b, info)) {
-			info.framesLeft = numCollisionFrames;
-			ImpulseResolveCollision(*info.a, *info.b, info.point);
-			allBroadPhaseCollisions.insert(info); // insert into our main set
+	++narrowPhaseStep; //every resolution in this pass, batched or not, stamps its objects with this
+
+	//Copy the shapes out first, so GJK can run over one flat array of pairs
+	narrowPhaseInfos.clear();
+	narrowPhasePairs.clear();
+	narrowPhaseCaches.clear();
+
+	for (int i = 0; i < broadPhasePairs.Size(); ++i) {
+		CollisionDetection::CollisionInfo info = broadPhasePairs[i];
+		GJKPair pair;
+		bool analytic = CollisionDetection::GetPairTest(info.a->GetBoundingVolume()->type, info.b->GetBoundingVolume()->type) != nullptr;
+		if (analytic || !ExtractGJKShape(info.a, pair.a) || !ExtractGJKShape(info.b, pair.b)) {
+			//closed form pairs, and volumes that can't be batched, go through their GameObjects
+			if (PairIntersection(info.a, info.b, info)) {
+				ResolveCollision(info);
+			}
+			continue;
 		}
+		narrowPhaseInfos.push_back(info);
+		narrowPhasePairs.push_back(pair);
+		narrowPhaseCaches.push_back(GetGJKCache(info.a, info.b));
 	}
 
+	narrowPhaseResults.resize(narrowPhasePairs.size());
+	GJKBatch(narrowPhasePairs.data(), narrowPhaseResults.data(), (int)narrowPhasePairs.size(), narrowPhaseCaches.data());
+
+	/*
+	Each pair is still resolved as soon as its contact's known, but the batch worked from
+	shapes copied out before the pairs above it were resolved, and before any of its own.
+	So a colliding pair with an object that any resolution this pass has moved is tested
+	again where it is now, or the position correction would use a stale penetration depth.
+	Pairs the batch found apart are left, as the corrections push objects apart, and the
+	next substep picks up anything they miss.
+	*/
+	for (size_t i = 0; i < narrowPhaseResults.size(); ++i) {
+		if (!narrowPhaseResults[i].colliding) {
+			continue;
+		}
+		CollisionDetection::CollisionInfo& info = narrowPhaseInfos[i];
+		if (MovedThisNarrowPhase(info.a) || MovedThisNarrowPhase(info.b)) {
+			if (PairIntersection(info.a, info.b, info)) {
+				ResolveCollision(info);
+			}
+			continue;
+		}
+		const CollisionDetection::ContactPoint& p = narrowPhaseResults[i].contact;
+		info.ClearContactPoints();
+		info.AddContactPoint(p.localA, p.localB, p.normal, p.penetration);
+		ResolveCollision(info);
+	}
+}
+
+void PhysicsSystem::ResolveCollision(CollisionDetection::CollisionInfo& info) {
+	GenerateContacts(info);
+	ImpulseResolveCollision(*info.a, *info.b, info);
+	AddPersistentContact(info);
+
+	//anything with mass gets pushed out by the resolution
+	GameObject* objects[2] = { info.a, info.b };
+	for (GameObject* object : objects) {
+		if (object->GetPhysicsObject()->GetInverseMass() == 0.0f) {
+			continue;
+		}
+		int id = object->GetWorldID();
+		if (id >= (int)narrowPhaseMoved.size()) {
+			narrowPhaseMoved.resize(id + 1, 0);
+		}
+		narrowPhaseMoved[id] = narrowPhaseStep;
+	}
+}
+
+bool PhysicsSystem::MovedThisNarrowPhase(const GameObject* object) const {
+	int id = object->GetWorldID();
+	return id < (int)narrowPhaseMoved.size() && narrowPhaseMoved[id] == narrowPhaseStep;
 }
 
 /*
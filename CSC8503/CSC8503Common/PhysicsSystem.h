@@ -1,11 +1,47 @@
 #pragma once
 #include "../CSC8503Common/GameWorld.h"
-#include <set>
+#include "GJK.h"
+#include "ContactManifold.h"
+#include "DynamicAABBTree.h"
+#include "SweepAndPrune.h"
+#include "SpatialHashGrid.h"
+#include "LooseOctree.h"
+#include "PairHashTable.h"
+#include "WorkerPool.h"
+#include <map>
+#include <vector>
 
 
 namespace NCL {
 	namespace CSC8503 {
 		class TutorialGame;
+
+		enum class BroadPhaseType {
+			QuadTree,		//built again every substep, into the same nodes
+			DynamicTree,	//kept between substeps, only objects that move far enough are updated
+			SweepAndPrune,	//kept sorted between substeps, good for piles of objects that barely move
+			SpatialHash,	//uniform grid, good for lots of objects of about the same size
+			LooseOctree,	//built again every substep like the QuadTree, but in 3D and without splitting objects up
+			MAX
+		};
+
+		//A pair that has collided, kept until it's gone numCollisionFrames frames without touching
+		struct PersistentContact {
+			CollisionDetection::CollisionInfo	info;
+			bool								begun = false; //OnCollisionBegin has been called for it
+		};
+
+		//Which proxy each object has in one of the persistent broadphases
+		struct BroadPhaseProxies {
+			std::vector<int> proxies;	//indexed by worldID, -1 if the object isn't in the broadphase
+			std::vector<int> steps;		//broadPhaseStep the object was last seen in, to find removed objects
+
+			void Clear() {
+				proxies.clear();
+				steps.clear();
+			}
+		};
+
 		class PhysicsSystem	{
 		public:
 			PhysicsSystem(GameWorld& g);
@@ -33,7 +69,17 @@ namespace NCL {
 		protected:
 			void BasicCollisionDetection();
 			void BroadPhase();
+			void QuadTreeBroadPhase();
+			void DynamicTreeBroadPhase();
+			void SweepAndPruneBroadPhase();
+			void SpatialHashBroadPhase();
+			void LooseOctreeBroadPhase();
+			bool UseParallelBroadPhase() const;
+			void AddBroadPhaseCandidates();
+			void AddBroadPhasePair(GameObject* a, GameObject* b);
 			void NarrowPhase();
+			void ResolveCollision(CollisionDetection::CollisionInfo& info);
+			bool MovedThisNarrowPhase(const GameObject* object) const;
 
 			void ClearForces();
 
@@ -43,10 +89,21 @@ namespace NCL {
 			void UpdateConstraints(float dt);
 
 			void UpdateCollisionList();
+			void AddPersistentContact(const CollisionDetection::CollisionInfo& info);
 
 			void UpdateObjectAABBs();
 
+			GJKCache* GetGJKCache(GameObject* a, GameObject* b);
+			void UpdateGJKCaches();
+
+			bool PairIntersection(GameObject* a, GameObject* b, CollisionDetection::CollisionInfo& info);
+
+			void GenerateContacts(CollisionDetection::CollisionInfo& info);
+			void UpdateContactManifolds();
+
 			void ImpulseResolveCollision(GameObject& a , GameObject&b, CollisionDetection::ContactPoint& p) const;
+			void ImpulseResolveCollision(GameObject& a, GameObject& b, CollisionDetection::CollisionInfo& info) const;
+			void ApplyContactImpulse(PhysicsObject& physA, PhysicsObject& physB, const CollisionDetection::ContactPoint& p) const;
 
 			GameWorld& gameWorld;
 
@@ -58,10 +115,38 @@ namespace NCL {
 			float staticCountMax;
 			float staticMaxPosMagn;
 
-			std::set<CollisionDetection::CollisionInfo> allBroadPhaseCollisions;
+			PairHashTable<CollisionDetection::CollisionInfo>	broadPhasePairs;	//this substep's pairs, rebuilt every substep
+			PairHashTable<PersistentContact>					persistentContacts;
+
+			std::map<uint64_t, GJKCache> gjkCaches; //keyed the same way as the pair tables
+			std::map<uint64_t, ContactManifold> contactManifolds;
+
+			QuadTree<GameObject*>			quadTree;
+			DynamicAABBTree<GameObject*>	dynamicTree;
+			BroadPhaseProxies				treeProxies;
+			SweepAndPrune<GameObject*>		sweepAndPrune;
+			BroadPhaseProxies				sweepProxies;
+			SpatialHashGrid<GameObject*>	spatialHash;
+			LooseOctree<GameObject*>		looseOctree;
+
+			std::vector<std::pair<GameObject*, GameObject*>> broadPhaseCandidates; //scratch space for the broadphases that give back a list of pairs
+			int								broadPhaseStep = 0;
+			WorkerPool						broadPhaseWorkers;
+
+			//Narrow phase scratch space, kept around so it isn't reallocated every substep
+			std::vector<CollisionDetection::CollisionInfo>	narrowPhaseInfos;
+			std::vector<GJKPair>							narrowPhasePairs;
+			std::vector<GJKCache*>							narrowPhaseCaches;
+			std::vector<GJKBatchResult>						narrowPhaseResults;
+			std::vector<int>								narrowPhaseMoved;	//indexed by worldID, the narrowPhaseStep the object was last moved by a resolution in
+			int												narrowPhaseStep = 0;
 
 
 			bool useBroadPhase		= true;
+			BroadPhaseType broadPhaseType = BroadPhaseType::DynamicTree;
+			bool parallelBroadPhase	= true;	//split the pair finding over broadPhaseWorkers
+			int parallelBroadPhaseMinObjects = 256; //below this waking the workers up costs more than it saves
+			bool usePersistentManifolds = false; //build manifolds over several frames instead of clipping every substep
 			int numCollisionFrames	= 5;
 
 			TutorialGame* tutorialGame;
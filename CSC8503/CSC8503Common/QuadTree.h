@@ -2,9 +2,12 @@
 #include "../../Common/Vector2.h"
 #include "../CSC8503Common/CollisionDetection.h"
 #include "Debug.h"
-#include <list>
+#include "WorkerPool.h"
+#include <vector>
 #include <functional>
 
+#define QUADTREE_NULL -1
+
 namespace NCL {
 	using namespace NCL::Maths;
 	namespace CSC8503 {
@@ -27,91 +30,26 @@ namespace NCL {
 		template<class T>
 		class QuadTreeNode	{
 		public:
-			typedef std::function<void(std::list<QuadTreeEntry<T>>&)> QuadTreeFunc;
-		protected:
-			friend class QuadTree<T>;
+			typedef std::function<void(std::vector<QuadTreeEntry<T>>&)> QuadTreeFunc;
 
 			QuadTreeNode() {}
 
-			QuadTreeNode(Vector2 pos, Vector2 size) {
-				children		= nullptr;
+		protected:
+			friend class QuadTree<T>;
+
+			void Reset(Vector2 pos, Vector2 size) {
+				children		= QUADTREE_NULL;
 				this->position	= pos;
 				this->size		= size;
+				contents.clear(); //keeps its memory for next time the node's used
 			}
 
-			~QuadTreeNode() {
-				delete[] children;
-			}
-
-			void Insert(T& object, const Vector3& objectPos, const Vector3& objectSize, int depthLeft, int maxSize) {
-				if (!CollisionDetection::AABBTest(objectPos,
-					Vector3(position.x, 0, position.y), objectSize,
-					Vector3(size.x, 1000.0f, size.y))) {
-					return;
-				}
-				if (children) { // not a leaf node , just descend the tree
-					for (int i = 0; i < 4; ++i) {
-						children[i].Insert(object, objectPos, objectSize,
-							depthLeft - 1, maxSize);
-					}
-				}
-				else { // currently a leaf node , can just expand
-					contents.push_back(QuadTreeEntry <T >(object, objectPos, objectSize));
-					if ((int)contents.size() > maxSize && depthLeft > 0) {
-						if (!children) {
-							Split();
-							// we need to reinsert the contents so far !
-							for (const auto& i : contents) {
-								for (int j = 0; j < 4; ++j) {
-									auto entry = i;
-									children[j].Insert(entry.object, entry.pos,
-										entry.size, depthLeft - 1, maxSize);
-								}
-							}
-							contents.clear(); // contents now distributed !
-						}
-					}
-				}
-			}
-
-			void Split() {
-				Vector2 halfSize = size / 2.0f;
-				children = new QuadTreeNode <T>[4];
-				children[0] = QuadTreeNode <T>(position +
-					Vector2(-halfSize.x, halfSize.y), halfSize);
-				children[1] = QuadTreeNode <T>(position +
-					Vector2(halfSize.x, halfSize.y), halfSize);
-				children[2] = QuadTreeNode <T>(position +
-					Vector2(-halfSize.x, -halfSize.y), halfSize);
-				children[3] = QuadTreeNode <T>(position +
-					Vector2(halfSize.x, -halfSize.y), halfSize);
-			}
-			
-
-			void DebugDraw() {
-
-			}
-
-			void OperateOnContents(QuadTreeFunc& func) {
-				if (children) {
-					for (int i = 0; i < 4; ++i) {
-						children[i].OperateOnContents(func);
-					}
-				}
-				else {
-					if (!contents.empty()) {
-						func(contents);
-					}
-				}
-			}
-
-		protected:
-			std::list< QuadTreeEntry<T> >	contents;
+			std::vector< QuadTreeEntry<T> >	contents;
 
 			Vector2 position;
 			Vector2 size;
 
-			QuadTreeNode<T>* children;
+			int children; //index of the first of 4 nodes in a row in the tree's pool, or QUADTREE_NULL for a leaf
 		};
 	}
 }
@@ -120,37 +58,125 @@ namespace NCL {
 namespace NCL {
 	using namespace NCL::Maths;
 	namespace CSC8503 {
+		/*
+		The nodes come from a pool in the tree, which Clear hands back all at once without
+		freeing anything, so a tree that's cleared and filled again every substep doesn't
+		allocate once it's been through a frame or two. Leaves keep their entries in
+		vectors, which keep their memory too when their node is reused.
+		*/
 		template<class T>
 		class QuadTree
 		{
 		public:
 			QuadTree(Vector2 size, int maxDepth = 6, int maxSize = 5){
-				root = QuadTreeNode<T>(Vector2(), size);
+				this->size		= size;
 				this->maxDepth	= maxDepth;
 				this->maxSize	= maxSize;
+				Clear();
 			}
 			~QuadTree() {
 			}
 
+			//Empties the tree, keeping all the nodes for reuse
+			void Clear() {
+				if (nodes.empty()) {
+					nodes.resize(1);
+				}
+				nodes[0].Reset(Vector2(), size);
+				usedNodes = 1;
+			}
+
 			void Insert(T object, const Vector3& pos, const Vector3& size) {
-				root.Insert(object, pos, size, maxDepth, maxSize);
+				Insert(0, object, pos, size, maxDepth);
 			}
 
 			void DebugDraw() {
-				root.DebugDraw();
+
 			}
 
 			void OperateOnContents(typename QuadTreeNode<T>::QuadTreeFunc  func) {
-				root.OperateOnContents(func);
+				for (int i = 0; i < usedNodes; ++i) {
+					QuadTreeNode<T>& n = nodes[i];
+					if (n.children == QUADTREE_NULL && !n.contents.empty()) {
+						func(n.contents);
+					}
+				}
+			}
+
+			/*
+			Adds every pair of objects sharing a leaf to pairs, with the leaves split up
+			between the pool's threads. A pair sharing more than one leaf is added once for
+			each, same as going through OperateOnContents.
+			*/
+			void FindPairs(WorkerPool& pool, std::vector<std::pair<T, T>>& pairs) {
+				pool.RunRanges(usedNodes, jobPairs, pairs,
+					[&](int, int first, int last, std::vector<std::pair<T, T>>& out) {
+						for (int n = first; n < last; ++n) {
+							if (nodes[n].children != QUADTREE_NULL) {
+								continue;
+							}
+							const std::vector<QuadTreeEntry<T>>& data = nodes[n].contents;
+							for (size_t i = 0; i < data.size(); ++i) {
+								for (size_t j = i + 1; j < data.size(); ++j) {
+									out.push_back(std::make_pair(data[i].object, data[j].object));
+								}
+							}
+						}
+					});
 			}
 
 		protected:
-			QuadTreeNode<T> root;
+			//nodes can be reallocated by a split, so they're always looked up by index in here
+			void Insert(int node, T& object, const Vector3& objectPos, const Vector3& objectSize, int depthLeft) {
+				if (!CollisionDetection::AABBTest(objectPos,
+					Vector3(nodes[node].position.x, 0, nodes[node].position.y), objectSize,
+					Vector3(nodes[node].size.x, 1000.0f, nodes[node].size.y))) {
+					return;
+				}
+				if (nodes[node].children != QUADTREE_NULL) { // not a leaf node , just descend the tree
+					for (int i = 0; i < 4; ++i) {
+						Insert(nodes[node].children + i, object, objectPos, objectSize, depthLeft - 1);
+					}
+					return;
+				}
+				// currently a leaf node , can just expand
+				nodes[node].contents.push_back(QuadTreeEntry <T >(object, objectPos, objectSize));
+				if ((int)nodes[node].contents.size() > maxSize && depthLeft > 0) {
+					Split(node);
+					// we need to reinsert the contents so far ! Each child only takes the entries that overlap it
+					for (size_t i = 0; i < nodes[node].contents.size(); ++i) {
+						QuadTreeEntry<T> entry = nodes[node].contents[i];
+						for (int j = 0; j < 4; ++j) {
+							Insert(nodes[node].children + j, entry.object, entry.pos, entry.size, depthLeft - 1);
+						}
+					}
+					nodes[node].contents.clear(); // contents now distributed !
+				}
+			}
+
+			void Split(int node) {
+				int first = usedNodes;
+				usedNodes += 4;
+				if ((int)nodes.size() < usedNodes) {
+					nodes.resize(usedNodes);
+				}
+				Vector2 position = nodes[node].position;
+				Vector2 halfSize = nodes[node].size / 2.0f;
+				nodes[first + 0].Reset(position + Vector2(-halfSize.x, halfSize.y), halfSize);
+				nodes[first + 1].Reset(position + Vector2(halfSize.x, halfSize.y), halfSize);
+				nodes[first + 2].Reset(position + Vector2(-halfSize.x, -halfSize.y), halfSize);
+				nodes[first + 3].Reset(position + Vector2(halfSize.x, -halfSize.y), halfSize);
+				nodes[node].children = first;
+			}
+
+			std::vector<QuadTreeNode<T>>	nodes;		//nodes[0] is the root
+			int								usedNodes;	//nodes past this are spare, left over from earlier fills
+
+			std::vector<std::vector<std::pair<T, T>>> jobPairs; //one per FindPairs job
+
+			Vector2 size;
 			int maxDepth;
 			int maxSize;
 		};
 	}
 }
-
-
-
@@ -0,0 +1,251 @@
+#pragma once
+#include "../../Common/Vector3.h"
+#include "WorkerPool.h"
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#define SPATIAL_HASH_CELL_SCALE	1.0f	//cells are this many times the median object's size
+#define SPATIAL_HASH_MAX_CELLS	64		//objects covering more cells than this are tested against everything instead
+
+namespace NCL {
+	using namespace NCL::Maths;
+	namespace CSC8503 {
+		/*
+		A uniform 3D grid, hashed so only the cells with something in them take up any
+		space. It's filled again every substep, but all its memory is kept, so nothing
+		more gets allocated once it's been as full as it's going to get.
+
+		The cell size comes from the median object's box, so it suits worlds full of
+		similar sized objects. Objects much bigger than that (floors, mostly) would cover
+		a huge number of cells, so they're kept to one side and tested against everything.
+		*/
+		template<class T>
+		class SpatialHashGrid {
+		public:
+			SpatialHashGrid() {
+				cellSize = 1.0f;
+			}
+			~SpatialHashGrid() {
+			}
+
+			//Empties the grid, keeping the memory for the next fill
+			void Clear() {
+				entries.clear();
+			}
+
+			void Insert(T object, const Vector3& pos, const Vector3& halfSizes) {
+				Entry e;
+				e.object	= object;
+				e.boundsMin = pos - halfSizes;
+				e.boundsMax = pos + halfSizes;
+				entries.push_back(e);
+			}
+
+			float GetCellSize() const {
+				return cellSize;
+			}
+
+			//Adds every pair of objects whose boxes overlap to pairs, each one once
+			void FindPairs(std::vector<std::pair<T, T>>& pairs) {
+				if (entries.empty()) {
+					return;
+				}
+				ChooseCellSize();
+				BuildCells();
+				FindCellPairs(0, (int)cells.size(), pairs);
+				FindOversizedPairs(0, (int)oversized.size(), pairs);
+			}
+
+			//As above, but with the cells and the oversized objects split up between the pool's threads
+			void FindPairs(WorkerPool& pool, std::vector<std::pair<T, T>>& pairs) {
+				if (entries.empty()) {
+					return;
+				}
+				ChooseCellSize();
+				BuildCells();
+				pool.RunRanges((int)cells.size(), jobPairs, pairs,
+					[&](int, int first, int last, std::vector<std::pair<T, T>>& out) {
+						FindCellPairs(first, last, out);
+					});
+				pool.RunRanges((int)oversized.size(), jobPairs, pairs,
+					[&](int, int first, int last, std::vector<std::pair<T, T>>& out) {
+						FindOversizedPairs(first, last, out);
+					});
+			}
+
+		protected:
+			struct Entry {
+				T		object;
+				Vector3 boundsMin;
+				Vector3 boundsMax;
+				int		cellMin[3];
+				int		cellMax[3];
+				bool	oversized;
+			};
+
+			//Open addressed, the cells hold runs of cellEntries
+			struct Cell {
+				int x;
+				int y;
+				int z;
+				int count;	//0 for an empty slot
+				int start;
+				int filled;	//how much of the run has been written so far
+			};
+
+			static bool Overlaps(const Entry& a, const Entry& b) {
+				return	a.boundsMin.x <= b.boundsMax.x && a.boundsMax.x >= b.boundsMin.x &&
+						a.boundsMin.y <= b.boundsMax.y && a.boundsMax.y >= b.boundsMin.y &&
+						a.boundsMin.z <= b.boundsMax.z && a.boundsMax.z >= b.boundsMin.z;
+			}
+
+			void FindCellPairs(int firstCell, int lastCell, std::vector<std::pair<T, T>>& pairs) const {
+				for (int cell = firstCell; cell < lastCell; ++cell) {
+					const Cell& c = cells[cell];
+					if (c.count == 0) {
+						continue;
+					}
+					for (int i = c.start; i < c.start + c.count; ++i) {
+						const Entry& a = entries[cellEntries[i]];
+						for (int j = i + 1; j < c.start + c.count; ++j) {
+							const Entry& b = entries[cellEntries[j]];
+							if (!Overlaps(a, b)) {
+								continue;
+							}
+							//a pair sharing several cells is only taken from the lowest one they share
+							if ((std::max)(a.cellMin[0], b.cellMin[0]) != c.x ||
+								(std::max)(a.cellMin[1], b.cellMin[1]) != c.y ||
+								(std::max)(a.cellMin[2], b.cellMin[2]) != c.z) {
+								continue;
+							}
+							pairs.push_back(std::make_pair(a.object, b.object));
+						}
+					}
+				}
+			}
+
+			void FindOversizedPairs(int first, int last, std::vector<std::pair<T, T>>& pairs) const {
+				for (int i = first; i < last; ++i) {
+					const Entry& a = entries[oversized[i]];
+					for (int j = 0; j < (int)entries.size(); ++j) {
+						const Entry& b = entries[j];
+						if (b.oversized && j <= oversized[i]) {
+							continue; //oversized pairs are only tested the once
+						}
+						if (Overlaps(a, b)) {
+							pairs.push_back(std::make_pair(a.object, b.object));
+						}
+					}
+				}
+			}
+
+			static uint32_t Hash(int x, int y, int z) {
+				return ((uint32_t)x * 73856093u) ^ ((uint32_t)y * 19349663u) ^ ((uint32_t)z * 83492791u);
+			}
+
+			void ChooseCellSize() {
+				sizes.clear();
+				for (const Entry& e : entries) {
+					Vector3 size = e.boundsMax - e.boundsMin;
+					sizes.push_back((std::max)((std::max)(size.x, size.y), size.z));
+				}
+				std::nth_element(sizes.begin(), sizes.begin() + sizes.size() / 2, sizes.end());
+				float median = sizes[sizes.size() / 2];
+				if (median > 0.0f) {
+					cellSize = median * SPATIAL_HASH_CELL_SCALE;
+				}
+			}
+
+			int FindCell(int x, int y, int z) {
+				uint32_t mask = (uint32_t)cells.size() - 1;
+				uint32_t slot = Hash(x, y, z) & mask;
+				while (cells[slot].count > 0 && (cells[slot].x != x || cells[slot].y != y || cells[slot].z != z)) {
+					slot = (slot + 1) & mask;
+				}
+				return (int)slot;
+			}
+
+			/*
+			A counting sort into the cells: each object counts itself into every cell it
+			touches, the counts give each cell its own run of cellEntries, and then the
+			objects are written into their runs.
+			*/
+			void BuildCells() {
+				float invCellSize = 1.0f / cellSize;
+				oversized.clear();
+				int numPlacements = 0;
+				for (int i = 0; i < (int)entries.size(); ++i) {
+					Entry& e = entries[i];
+					int covered = 1;
+					for (int axis = 0; axis < 3; ++axis) {
+						e.cellMin[axis] = (int)floor(e.boundsMin.array[axis] * invCellSize);
+						e.cellMax[axis] = (int)floor(e.boundsMax.array[axis] * invCellSize);
+						covered *= e.cellMax[axis] - e.cellMin[axis] + 1;
+					}
+					e.oversized = covered > SPATIAL_HASH_MAX_CELLS;
+					if (e.oversized) {
+						oversized.push_back(i);
+					}
+					else {
+						numPlacements += covered;
+					}
+				}
+
+				size_t capacity = 16;
+				while (capacity < (size_t)numPlacements * 2) {
+					capacity *= 2; //at most half full, so the probe runs stay short
+				}
+				Cell empty = { 0, 0, 0, 0, 0, 0 };
+				cells.assign((std::max)(capacity, cells.size()), empty);
+
+				for (const Entry& e : entries) {
+					if (e.oversized) {
+						continue;
+					}
+					for (int z = e.cellMin[2]; z <= e.cellMax[2]; ++z) {
+						for (int y = e.cellMin[1]; y <= e.cellMax[1]; ++y) {
+							for (int x = e.cellMin[0]; x <= e.cellMax[0]; ++x) {
+								Cell& c = cells[FindCell(x, y, z)];
+								c.x = x;
+								c.y = y;
+								c.z = z;
+								c.count++;
+							}
+						}
+					}
+				}
+				int start = 0;
+				for (Cell& c : cells) {
+					c.start		= start;
+					c.filled	= 0;
+					start		+= c.count;
+				}
+				cellEntries.resize(numPlacements);
+				for (int i = 0; i < (int)entries.size(); ++i) {
+					const Entry& e = entries[i];
+					if (e.oversized) {
+						continue;
+					}
+					for (int z = e.cellMin[2]; z <= e.cellMax[2]; ++z) {
+						for (int y = e.cellMin[1]; y <= e.cellMax[1]; ++y) {
+							for (int x = e.cellMin[0]; x <= e.cellMax[0]; ++x) {
+								Cell& c = cells[FindCell(x, y, z)];
+								cellEntries[c.start + c.filled++] = i;
+							}
+						}
+					}
+				}
+			}
+
+			std::vector<Entry>	entries;
+			std::vector<Cell>	cells;			//size is a power of two
+			std::vector<int>	cellEntries;	//entries index for each object in each cell it touches
+			std::vector<int>	oversized;
+			std::vector<float>	sizes;
+			std::vector<std::vector<std::pair<T, T>>> jobPairs; //one per job, for the threaded FindPairs
+			float				cellSize;
+		};
+	}
+}
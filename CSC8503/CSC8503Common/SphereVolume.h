@@ -32,6 +32,14 @@ namespace NCL {
 			//return collision.collidedAt;
 		}
 
+		float GetMargin() const {
+			return radius;
+		}
+
+		Vector3 CoreSupport(const Vector3&, const Transform& transform) {
+			return transform.GetPosition();
+		}
+
 	protected:
 		float	radius;
 	};
@@ -0,0 +1,244 @@
+#pragma once
+#include "../../Common/Vector3.h"
+#include "WorkerPool.h"
+#include <vector>
+#include <functional>
+#include <algorithm>
+#include <iterator>
+
+#define SAP_NULL -1
+#define SAP_AXIS_SWITCH 1.5f //another axis has to be this much more spread out before the sort axis changes
+
+namespace NCL {
+	using namespace NCL::Maths;
+	namespace CSC8503 {
+		/*
+		Sort and sweep over the objects' boxes. The lower ends of the boxes along one axis
+		are kept sorted from one substep to the next, and as objects hardly move in a substep
+		an insertion sort gets them back in order in close to linear time. Sweeping along the
+		sorted ends, each box is only tested against the boxes that start before it ends.
+
+		The sort axis is whichever the boxes' centres are most spread out along. Each update's
+		pairs are compared with the last update's, giving the pairs that have started and
+		stopped overlapping as well as all the current ones.
+		*/
+		template<class T>
+		class SweepAndPrune {
+		public:
+			typedef std::function<void(T, T)> SAPPairFunc;
+
+			SweepAndPrune() {
+				axis		= 0;
+				freeList	= SAP_NULL;
+			}
+			~SweepAndPrune() {
+			}
+
+			void Clear() {
+				proxies.clear();
+				endpoints.clear();
+				pairs.clear();
+				addedPairs.clear();
+				removedPairs.clear();
+				freeList = SAP_NULL;
+			}
+
+			//Returns the proxy to Move and Remove the object with later
+			int Insert(T object, const Vector3& pos, const Vector3& halfSizes) {
+				int proxy = freeList;
+				if (proxy == SAP_NULL) {
+					proxies.push_back(Proxy());
+					proxy = (int)proxies.size() - 1;
+				}
+				else {
+					freeList = proxies[proxy].nextFree;
+				}
+				Proxy& p = proxies[proxy];
+				p.object	= object;
+				p.boundsMin = pos - halfSizes;
+				p.boundsMax = pos + halfSizes;
+				p.nextFree	= SAP_NULL;
+
+				Endpoint e;
+				e.value = p.boundsMin.array[axis];
+				e.proxy = proxy;
+				endpoints.push_back(e); //sorted into place by the next UpdatePairs
+				return proxy;
+			}
+
+			//Pairs with the object are dropped without a removed event, as the object may be gone already
+			void Remove(int proxy) {
+				endpoints.erase(std::remove_if(endpoints.begin(), endpoints.end(),
+					[proxy](const Endpoint& e) { return e.proxy == proxy; }), endpoints.end());
+				pairs.erase(std::remove_if(pairs.begin(), pairs.end(),
+					[proxy](const std::pair<int, int>& p) { return p.first == proxy || p.second == proxy; }), pairs.end());
+
+				proxies[proxy].object	= T();
+				proxies[proxy].nextFree	= freeList;
+				freeList = proxy;
+			}
+
+			void Move(int proxy, const Vector3& pos, const Vector3& halfSizes) {
+				proxies[proxy].boundsMin = pos - halfSizes;
+				proxies[proxy].boundsMax = pos + halfSizes;
+			}
+
+			T GetObject(int proxy) const {
+				return proxies[proxy].object;
+			}
+
+			int GetAxis() const {
+				return axis;
+			}
+
+			//Sorts and sweeps with the boxes given since the last update
+			void UpdatePairs() {
+				SortEndpoints();
+				previousPairs.swap(pairs);
+				pairs.clear();
+				Sweep(0, (int)endpoints.size(), pairs);
+				DiffPairs();
+			}
+
+			//As above, but the sweep is split into runs of endpoints, one per job, across the pool's threads
+			void UpdatePairs(WorkerPool& pool) {
+				SortEndpoints();
+				previousPairs.swap(pairs);
+				pairs.clear();
+				pool.RunRanges((int)endpoints.size(), jobPairs, pairs,
+					[&](int, int first, int last, std::vector<std::pair<int, int>>& out) {
+						Sweep(first, last, out);
+					});
+				DiffPairs();
+			}
+
+			//Every pair overlapping as of the last UpdatePairs
+			void OperateOnPairs(SAPPairFunc func) {
+				for (const std::pair<int, int>& p : pairs) {
+					func(proxies[p.first].object, proxies[p.second].object);
+				}
+			}
+
+			//Pairs that started overlapping in the last UpdatePairs
+			void OperateOnAddedPairs(SAPPairFunc func) {
+				for (const std::pair<int, int>& p : addedPairs) {
+					func(proxies[p.first].object, proxies[p.second].object);
+				}
+			}
+
+			//Pairs that stopped overlapping in the last UpdatePairs
+			void OperateOnRemovedPairs(SAPPairFunc func) {
+				for (const std::pair<int, int>& p : removedPairs) {
+					func(proxies[p.first].object, proxies[p.second].object);
+				}
+			}
+
+		protected:
+			struct Proxy {
+				T		object;
+				Vector3 boundsMin;
+				Vector3 boundsMax;
+				int		nextFree;
+			};
+
+			struct Endpoint {
+				float	value;	//boundsMin of the proxy on the sort axis
+				int		proxy;
+			};
+
+			void SortEndpoints() {
+				bool axisChanged = ChooseAxis();
+				for (Endpoint& e : endpoints) {
+					e.value = proxies[e.proxy].boundsMin.array[axis];
+				}
+				if (axisChanged) {
+					std::sort(endpoints.begin(), endpoints.end(),
+						[](const Endpoint& a, const Endpoint& b) { return a.value < b.value; });
+				}
+				else {
+					InsertionSort();
+				}
+			}
+
+			//Finds the pairs for the boxes starting at endpoints first to last, each of which can run on past last
+			void Sweep(int first, int last, std::vector<std::pair<int, int>>& out) const {
+				int otherAxisA = (axis + 1) % 3;
+				int otherAxisB = (axis + 2) % 3;
+				for (int i = first; i < last; ++i) {
+					const Proxy& a = proxies[endpoints[i].proxy];
+					float end = a.boundsMax.array[axis];
+					for (int j = i + 1; j < (int)endpoints.size() && endpoints[j].value <= end; ++j) {
+						const Proxy& b = proxies[endpoints[j].proxy];
+						if (a.boundsMin.array[otherAxisA] <= b.boundsMax.array[otherAxisA] && a.boundsMax.array[otherAxisA] >= b.boundsMin.array[otherAxisA] &&
+							a.boundsMin.array[otherAxisB] <= b.boundsMax.array[otherAxisB] && a.boundsMax.array[otherAxisB] >= b.boundsMin.array[otherAxisB]) {
+							int pa = endpoints[i].proxy;
+							int pb = endpoints[j].proxy;
+							out.push_back(std::make_pair((std::min)(pa, pb), (std::max)(pa, pb)));
+						}
+					}
+				}
+			}
+
+			//Sorts the new pairs and compares them with the last update's
+			void DiffPairs() {
+				std::sort(pairs.begin(), pairs.end());
+
+				addedPairs.clear();
+				removedPairs.clear();
+				std::set_difference(pairs.begin(), pairs.end(), previousPairs.begin(), previousPairs.end(), std::back_inserter(addedPairs));
+				std::set_difference(previousPairs.begin(), previousPairs.end(), pairs.begin(), pairs.end(), std::back_inserter(removedPairs));
+			}
+
+			//Returns true if the axis has changed, in which case the order is no use for the insertion sort
+			bool ChooseAxis() {
+				if (endpoints.empty()) {
+					return false;
+				}
+				Vector3 sum;
+				Vector3 sumSq;
+				for (const Endpoint& e : endpoints) {
+					const Proxy& p = proxies[e.proxy];
+					Vector3 centre = (p.boundsMin + p.boundsMax) * 0.5f;
+					sum		= sum + centre;
+					sumSq	= sumSq + centre * centre;
+				}
+				Vector3 variance = sumSq - (sum * sum) / (float)endpoints.size();
+
+				int best = axis;
+				for (int i = 0; i < 3; ++i) {
+					if (variance.array[i] > variance.array[best] * SAP_AXIS_SWITCH) {
+						best = i;
+					}
+				}
+				if (best == axis) {
+					return false;
+				}
+				axis = best;
+				return true;
+			}
+
+			void InsertionSort() {
+				for (int i = 1; i < (int)endpoints.size(); ++i) {
+					Endpoint e = endpoints[i];
+					int j = i - 1;
+					while (j >= 0 && endpoints[j].value > e.value) {
+						endpoints[j + 1] = endpoints[j];
+						--j;
+					}
+					endpoints[j + 1] = e;
+				}
+			}
+
+			std::vector<Proxy>		proxies;
+			std::vector<Endpoint>	endpoints;	//in order along the sort axis
+			int						axis;
+			int						freeList;
+
+			std::vector<std::pair<int, int>> pairs;			//proxy pairs, lower proxy first, sorted
+			std::vector<std::pair<int, int>> previousPairs;
+			std::vector<std::pair<int, int>> addedPairs;
+			std::vector<std::pair<int, int>> removedPairs;
+			std::vector<std::vector<std::pair<int, int>>> jobPairs; //one per job, for the threaded UpdatePairs
+		};
+	}
+}
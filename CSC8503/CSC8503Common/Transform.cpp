@@ -4,7 +4,9 @@ using namespace NCL::CSC8503;
 
 Transform::Transform()
 {
-	scale	= Vector3(1, 1, 1);
+	scale			= Vector3(1, 1, 1);
+	rotationDirty	= true;
+	matrixDirty		= true;
 }
 
 Transform::~Transform()
@@ -12,27 +14,35 @@ Transform::~Transform()
 
 }
 
-void Transform::UpdateMatrix() {
+void Transform::UpdateMatrix() const {
 	matrix =
 		Matrix4::Translation(position) *
 		Matrix4(orientation) *
 		Matrix4::Scale(scale);
+	matrixDirty = false;
+}
+
+void Transform::UpdateRotMatrix() const {
+	rotMatrix		= Matrix3(orientation);
+	invRotMatrix	= rotMatrix.Transposed();
+	rotationDirty	= false;
 }
 
 Transform& Transform::SetPosition(const Vector3& worldPos) {
 	position = worldPos;
-	UpdateMatrix();
+	matrixDirty = true;
 	return *this;
 }
 
 Transform& Transform::SetScale(const Vector3& worldScale) {
 	scale = worldScale;
-	UpdateMatrix();
+	matrixDirty = true;
 	return *this;
 }
 
 Transform& Transform::SetOrientation(const Quaternion& worldOrientation) {
 	orientation = worldOrientation;
-	UpdateMatrix();
+	rotationDirty = true;
+	matrixDirty = true;
 	return *this;
 }
\ No newline at end of file
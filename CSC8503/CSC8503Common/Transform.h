@@ -34,26 +34,47 @@ namespace NCL {
 				return orientation;
 			}
 
-			Matrix4 GetMatrix() const {
+			//Setting position, orientation or scale only marks the matrix as out of date, it's rebuilt
+			//here, once, however many times the physics moved the object since it was last read
+			const Matrix4& GetMatrix() const {
+				if (matrixDirty) {
+					UpdateMatrix();
+				}
 				return matrix;
 			}
 
 
-			Matrix3 GetRotMatrix() const {
-				return Matrix3(orientation);
+			//Rotation matrices are only rebuilt the first time they're asked for after the orientation changes,
+			//GJK asks for them on every support call
+			const Matrix3& GetRotMatrix() const {
+				if (rotationDirty) {
+					UpdateRotMatrix();
+				}
+				return rotMatrix;
 			}
 
-			Matrix3 GetInvRotMatrix() const {
-				return Matrix3(orientation.Conjugate());
+			const Matrix3& GetInvRotMatrix() const {
+				if (rotationDirty) {
+					UpdateRotMatrix();
+				}
+				return invRotMatrix;
 			}
 
-			void UpdateMatrix();
+			void UpdateMatrix() const;
 		protected:
-			Matrix4		matrix;
+			void UpdateRotMatrix() const;
+
 			Quaternion	orientation;
 			Vector3		position;
 
 			Vector3		scale;
+
+			mutable Matrix4 matrix;
+			mutable bool	matrixDirty;
+
+			mutable Matrix3 rotMatrix;
+			mutable Matrix3 invRotMatrix;	//transpose of rotMatrix, same as the conjugate's matrix
+			mutable bool	rotationDirty;
 		};
 	}
 }
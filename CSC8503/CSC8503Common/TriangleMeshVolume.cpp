@@ -0,0 +1,211 @@
+#include "TriangleMeshVolume.h"
+#include <algorithm>
+#include <cfloat>
+#include <cassert>
+
+using namespace NCL;
+
+#define TRIANGLE_MESH_MAX_DEPTH 64 //traversal stack, the tree is balanced so this is never close
+
+TriangleMeshVolume::TriangleMeshVolume(const MeshGeometry& mesh, const Vector3& scale) {
+	type = VolumeType::TriangleMesh;
+
+	Triangle t;
+	for (unsigned int i = 0; mesh.GetTriangle(i, t.v[0], t.v[1], t.v[2]); ++i) {
+		for (int j = 0; j < 3; ++j) {
+			t.v[j] = t.v[j] * scale;
+		}
+		triangles.push_back(t);
+	}
+	if (triangles.empty()) {
+		return;
+	}
+	nodes.reserve(2 * (triangles.size() / TRIANGLE_MESH_LEAF_SIZE + 1));
+	BuildNode(0, (int)triangles.size());
+}
+
+Vector3 TriangleMeshVolume::GetLocalCentre() const {
+	if (nodes.empty()) {
+		return Vector3();
+	}
+	return (nodes[0].boundsMin + nodes[0].boundsMax) * 0.5f;
+}
+
+Vector3 TriangleMeshVolume::GetLocalHalfSizes() const {
+	if (nodes.empty()) {
+		return Vector3();
+	}
+	return (nodes[0].boundsMax - nodes[0].boundsMin) * 0.5f;
+}
+
+Vector3 TriangleMeshVolume::Support(const Vector3& dir, const Transform& transform) {
+	Vector3 localDir = transform.GetInvRotMatrix() * dir;
+
+	Vector3 best;
+	float	bestDot = -FLT_MAX;
+	for (const Triangle& t : triangles) {
+		for (int i = 0; i < 3; ++i) {
+			float d = Vector3::Dot(t.v[i], localDir);
+			if (d > bestDot) {
+				bestDot = d;
+				best	= t.v[i];
+			}
+		}
+	}
+	return transform.GetRotMatrix() * best + transform.GetPosition();
+}
+
+static bool TriangleOverlapsBox(const Vector3* corners, const Vector3& boxMin, const Vector3& boxMax) {
+	for (int axis = 0; axis < 3; ++axis) {
+		float lo = std::min(std::min(corners[0].array[axis], corners[1].array[axis]), corners[2].array[axis]);
+		float hi = std::max(std::max(corners[0].array[axis], corners[1].array[axis]), corners[2].array[axis]);
+		if (lo > boxMax.array[axis] || hi < boxMin.array[axis]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void TriangleMeshVolume::GetOverlappingTriangles(const Vector3& boxMin, const Vector3& boxMax, std::vector<int>& overlapping) const {
+	overlapping.clear();
+	if (nodes.empty()) {
+		return;
+	}
+	int stack[TRIANGLE_MESH_MAX_DEPTH];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0) {
+		const Node& n = nodes[stack[--stackSize]];
+		if (n.boundsMin.x > boxMax.x || n.boundsMax.x < boxMin.x ||
+			n.boundsMin.y > boxMax.y || n.boundsMax.y < boxMin.y ||
+			n.boundsMin.z > boxMax.z || n.boundsMax.z < boxMin.z) {
+			continue;
+		}
+		if (n.left >= 0) {
+			stack[stackSize++] = n.left;
+			stack[stackSize++] = n.right;
+			continue;
+		}
+		//The leaf's box is around all its triangles, check each one's own box too
+		for (int i = n.first; i < n.first + n.count; ++i) {
+			if (TriangleOverlapsBox(triangles[i].v, boxMin, boxMax)) {
+				overlapping.push_back(i);
+			}
+		}
+	}
+#ifdef _DEBUG
+	//The tree should only ever skip triangles the loop over all of them would have skipped too
+	int bruteForce = 0;
+	for (const Triangle& t : triangles) {
+		bruteForce += TriangleOverlapsBox(t.v, boxMin, boxMax) ? 1 : 0;
+	}
+	assert(bruteForce == (int)overlapping.size());
+#endif
+}
+
+//Slab test against a node's box, giving where the ray enters it
+static bool RayNodeTest(const Vector3& rayPos, const Vector3& invDir, const Vector3& boundsMin, const Vector3& boundsMax, float maxDistance, float& entry) {
+	float tMin = 0.0f;
+	float tMax = maxDistance;
+	for (int axis = 0; axis < 3; ++axis) {
+		float t0 = (boundsMin.array[axis] - rayPos.array[axis]) * invDir.array[axis];
+		float t1 = (boundsMax.array[axis] - rayPos.array[axis]) * invDir.array[axis];
+		if (t0 > t1) {
+			std::swap(t0, t1);
+		}
+		tMin = std::max(tMin, t0);
+		tMax = std::min(tMax, t1);
+		if (tMin > tMax) {
+			return false;
+		}
+	}
+	entry = tMin;
+	return true;
+}
+
+bool TriangleMeshVolume::RayCast(const Vector3& rayPos, const Vector3& rayDir, float maxDistance, float& distance, int& triangle) const {
+	if (nodes.empty()) {
+		return false;
+	}
+	//Divide by zero gives infinities here, which the slab test copes with
+	Vector3 invDir(1.0f / rayDir.x, 1.0f / rayDir.y, 1.0f / rayDir.z);
+
+	float nearest	= maxDistance;
+	triangle		= -1;
+
+	int stack[TRIANGLE_MESH_MAX_DEPTH];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0) {
+		const Node& n = nodes[stack[--stackSize]];
+		float entry;
+		if (!RayNodeTest(rayPos, invDir, n.boundsMin, n.boundsMax, nearest, entry)) {
+			continue; //also skips nodes that are all further away than the best hit so far
+		}
+		if (n.left >= 0) {
+			stack[stackSize++] = n.left;
+			stack[stackSize++] = n.right;
+			continue;
+		}
+		for (int i = n.first; i < n.first + n.count; ++i) {
+			float dist;
+			if (RayTriangleIntersection(rayPos, rayDir, triangles[i].v, dist) && dist < nearest) {
+				nearest		= dist;
+				triangle	= i;
+			}
+		}
+	}
+	distance = nearest;
+	return triangle >= 0;
+}
+
+//Top down, splitting at the median triangle along the axis the triangles' centres are most spread out on
+int TriangleMeshVolume::BuildNode(int first, int count) {
+	int index = (int)nodes.size();
+	nodes.push_back(Node());
+
+	Vector3 boundsMin(FLT_MAX, FLT_MAX, FLT_MAX);
+	Vector3 boundsMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	Vector3 centreMin = boundsMin;
+	Vector3 centreMax = boundsMax;
+	for (int i = first; i < first + count; ++i) {
+		const Triangle& t = triangles[i];
+		Vector3 centre = (t.v[0] + t.v[1] + t.v[2]) / 3.0f;
+		for (int axis = 0; axis < 3; ++axis) {
+			for (int j = 0; j < 3; ++j) {
+				boundsMin.array[axis] = std::min(boundsMin.array[axis], t.v[j].array[axis]);
+				boundsMax.array[axis] = std::max(boundsMax.array[axis], t.v[j].array[axis]);
+			}
+			centreMin.array[axis] = std::min(centreMin.array[axis], centre.array[axis]);
+			centreMax.array[axis] = std::max(centreMax.array[axis], centre.array[axis]);
+		}
+	}
+	nodes[index].boundsMin	= boundsMin;
+	nodes[index].boundsMax	= boundsMax;
+	nodes[index].first		= first;
+	nodes[index].count		= count;
+
+	if (count <= TRIANGLE_MESH_LEAF_SIZE) {
+		nodes[index].left	= -1;
+		nodes[index].right	= -1;
+		return index;
+	}
+
+	Vector3 spread = centreMax - centreMin;
+	int axis = 0;
+	if (spread.y > spread.array[axis]) axis = 1;
+	if (spread.z > spread.array[axis]) axis = 2;
+
+	int half = count / 2;
+	std::nth_element(triangles.begin() + first, triangles.begin() + first + half, triangles.begin() + first + count,
+		[axis](const Triangle& a, const Triangle& b) {
+			return	a.v[0].array[axis] + a.v[1].array[axis] + a.v[2].array[axis] <
+					b.v[0].array[axis] + b.v[1].array[axis] + b.v[2].array[axis];
+		});
+
+	int left	= BuildNode(first, half);
+	int right	= BuildNode(first + half, count - half);
+	nodes[index].left	= left;
+	nodes[index].right	= right;
+	return index;
+}
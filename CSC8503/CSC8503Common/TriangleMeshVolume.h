@@ -0,0 +1,125 @@
+#pragma once
+#include "CollisionVolume.h"
+#include "../../Common/Vector3.h"
+#include "../../Common/MeshGeometry.h"
+#include <vector>
+
+#define TRIANGLE_MESH_LEAF_SIZE 4 //triangles per BVH leaf
+#define TRIANGLE_RAY_EPSILON 0.000001f
+
+namespace NCL {
+	//Moller-Trumbore, hitting the triangle from either side
+	inline bool RayTriangleIntersection(const Vector3& rayPos, const Vector3& rayDir, const Vector3* corners, float& distance) {
+		Vector3 edge1 = corners[1] - corners[0];
+		Vector3 edge2 = corners[2] - corners[0];
+		Vector3 p = Vector3::Cross(rayDir, edge2);
+		float det = Vector3::Dot(edge1, p);
+		if (fabs(det) < TRIANGLE_RAY_EPSILON) {
+			return false; //ray is parallel to the triangle
+		}
+		float invDet = 1.0f / det;
+		Vector3 s = rayPos - corners[0];
+		float u = Vector3::Dot(s, p) * invDet;
+		if (u < 0.0f || u > 1.0f) {
+			return false;
+		}
+		Vector3 q = Vector3::Cross(s, edge1);
+		float v = Vector3::Dot(rayDir, q) * invDet;
+		if (v < 0.0f || u + v > 1.0f) {
+			return false;
+		}
+		distance = Vector3::Dot(edge2, q) * invDet;
+		return distance >= 0.0f;
+	}
+
+	//One triangle, in the space of the object it belongs to. Triangle meshes and heightfields
+	//hand these to GJK one at a time, as they aren't convex as a whole.
+	class TriangleVolume : public CollisionVolume
+	{
+	public:
+		TriangleVolume() {
+			type = VolumeType::TriangleMesh;
+		}
+		~TriangleVolume() {}
+
+		void SetVertices(const Vector3& a, const Vector3& b, const Vector3& c) {
+			vertices[0] = a;
+			vertices[1] = b;
+			vertices[2] = c;
+		}
+
+		Vector3 Support(const Vector3& dir, const Transform& transform) {
+			Vector3 localDir = transform.GetInvRotMatrix() * dir;
+
+			int best = 0;
+			float bestDot = Vector3::Dot(vertices[0], localDir);
+			for (int i = 1; i < 3; ++i) {
+				float d = Vector3::Dot(vertices[i], localDir);
+				if (d > bestDot) {
+					bestDot = d;
+					best	= i;
+				}
+			}
+			return transform.GetRotMatrix() * vertices[best] + transform.GetPosition();
+		}
+
+	protected:
+		Vector3 vertices[3];
+	};
+
+	/*
+	Static, non convex geometry made of a mesh's triangles, for level geometry. The triangles
+	are kept in a bounding volume hierarchy, so a shape is only tested against the triangles
+	whose bounds overlap its own, and a ray only visits the nodes it passes through.
+	Meant for objects with PhysicsType::Static; two triangle meshes never collide.
+	*/
+	class TriangleMeshVolume : public CollisionVolume
+	{
+	public:
+		//scale is applied to the vertices, as the render scale on the transform isn't used by collisions
+		TriangleMeshVolume(const MeshGeometry& mesh, const Vector3& scale = Vector3(1, 1, 1));
+		~TriangleMeshVolume() {}
+
+		int GetNumTriangles() const {
+			return (int)triangles.size();
+		}
+
+		//Model space corners of triangle i
+		void GetTriangle(int i, Vector3* corners) const {
+			corners[0] = triangles[i].v[0];
+			corners[1] = triangles[i].v[1];
+			corners[2] = triangles[i].v[2];
+		}
+
+		//Triangles whose bounds overlap the box, which is in the mesh's space
+		void GetOverlappingTriangles(const Vector3& boxMin, const Vector3& boxMax, std::vector<int>& overlapping) const;
+
+		//Nearest triangle the ray hits within maxDistance, all in the mesh's space
+		bool RayCast(const Vector3& rayPos, const Vector3& rayDir, float maxDistance, float& distance, int& triangle) const;
+
+		Vector3 GetLocalCentre() const;
+		Vector3 GetLocalHalfSizes() const;
+
+		//Furthest vertex along dir. The mesh isn't convex, so this is only good for bounds.
+		Vector3 Support(const Vector3& dir, const Transform& transform);
+
+	protected:
+		struct Triangle {
+			Vector3 v[3];
+		};
+
+		struct Node {
+			Vector3 boundsMin;
+			Vector3 boundsMax;
+			int		left;	//-1 for a leaf
+			int		right;
+			int		first;	//leaves hold triangles[first] up to triangles[first + count]
+			int		count;
+		};
+
+		int BuildNode(int first, int count);
+
+		std::vector<Triangle>	triangles;	//in leaf order once the tree is built
+		std::vector<Node>		nodes;		//nodes[0] is the root
+	};
+}
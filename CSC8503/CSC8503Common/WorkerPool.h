@@ -0,0 +1,165 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <algorithm>
+
+#define WORKER_POOL_JOBS_PER_THREAD 4 //more jobs than threads, so one slow job doesn't hold everyone else up
+
+namespace NCL {
+	namespace CSC8503 {
+		/*
+		A fixed set of threads that sit waiting for Run to hand them some jobs. The thread
+		calling Run works through the jobs too, and Run doesn't return until all of them are
+		done, so anything the jobs touch only has to stay put for the length of the call.
+		The threads are started once and kept, as starting them every substep would cost
+		more than the work they'd be doing.
+		*/
+		class WorkerPool {
+		public:
+			typedef std::function<void(int)> JobFunc;
+
+			//numThreads counts the thread calling Run, 0 means one per hardware thread
+			WorkerPool(int numThreads = 0) {
+				if (numThreads <= 0) {
+					numThreads = (std::max)(1, (int)std::thread::hardware_concurrency());
+				}
+				this->numThreads = numThreads;
+				generation	= 0;
+				numJobs		= 0;
+				jobsDone	= 0;
+				active		= 0;
+				stopping	= false;
+				nextJob		= 0;
+				job			= nullptr;
+				for (int i = 1; i < numThreads; ++i) {
+					threads.push_back(std::thread(&WorkerPool::WorkerThread, this));
+				}
+			}
+			~WorkerPool() {
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					stopping = true;
+				}
+				wake.notify_all();
+				for (std::thread& t : threads) {
+					t.join();
+				}
+			}
+
+			int GetNumThreads() const {
+				return numThreads;
+			}
+
+			int GetNumJobs() const {
+				return numThreads * WORKER_POOL_JOBS_PER_THREAD;
+			}
+
+			//Calls func with every job index from 0 to count - 1, spread over the threads
+			void Run(int count, const JobFunc& func) {
+				if (count <= 0) {
+					return;
+				}
+				if (threads.empty()) {
+					for (int i = 0; i < count; ++i) {
+						func(i);
+					}
+					return;
+				}
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					job			= &func;
+					numJobs		= count;
+					jobsDone	= 0;
+					nextJob		= 0;
+					generation++;
+				}
+				wake.notify_all();
+
+				int done = DoJobs(func, count);
+
+				std::unique_lock<std::mutex> lock(mutex);
+				jobsDone += done;
+				//workers still inside DoJobs could pick up the next Run's jobs with this func, so wait them out too
+				finished.wait(lock, [&] { return jobsDone == numJobs && active == 0; });
+				job = nullptr;
+			}
+
+			/*
+			Splits count items into at most GetNumJobs() ranges, and runs func(job, first, last, out)
+			on each range with a buffer of its own to write into, so the jobs never share
+			anything they write to. The buffers are appended to out in range order, so out
+			comes out the same however the jobs were spread over the threads.
+			*/
+			template<class P, class RangeFunc>
+			void RunRanges(int count, std::vector<std::vector<P>>& buffers, std::vector<P>& out, RangeFunc func) {
+				int jobs = (std::max)(1, (std::min)(count, GetNumJobs()));
+				if ((int)buffers.size() < jobs) {
+					buffers.resize(jobs);
+				}
+				Run(jobs, [&](int i) {
+					buffers[i].clear();
+					func(i, (int)((long long)count * i / jobs), (int)((long long)count * (i + 1) / jobs), buffers[i]);
+				});
+				for (int i = 0; i < jobs; ++i) {
+					out.insert(out.end(), buffers[i].begin(), buffers[i].end());
+				}
+			}
+
+		protected:
+			int DoJobs(const JobFunc& func, int count) {
+				int done = 0;
+				for (int i = nextJob++; i < count; i = nextJob++) {
+					func(i);
+					done++;
+				}
+				return done;
+			}
+
+			void WorkerThread() {
+				int seen = 0;
+				std::unique_lock<std::mutex> lock(mutex);
+				for (;;) {
+					wake.wait(lock, [&] { return stopping || generation != seen; });
+					if (stopping) {
+						return;
+					}
+					seen = generation;
+					if (!job) {
+						continue; //woke up too late, the Run has already been and gone
+					}
+					const JobFunc& func = *job;
+					int count = numJobs;
+					active++;
+					lock.unlock();
+
+					int done = DoJobs(func, count);
+
+					lock.lock();
+					active--;
+					jobsDone += done;
+					if (jobsDone == numJobs && active == 0) {
+						finished.notify_all();
+					}
+				}
+			}
+
+			std::vector<std::thread>	threads;
+			int							numThreads;
+
+			std::mutex				mutex;		//guards everything below but nextJob
+			std::condition_variable wake;		//for the workers, when there's a new Run or the pool's closing
+			std::condition_variable finished;	//for Run, when the last job is done
+			const JobFunc*			job;
+			int						generation;	//goes up by one every Run, so the workers can tell a new one has started
+			int						numJobs;
+			int						jobsDone;
+			int						active;		//workers inside DoJobs
+			bool					stopping;
+			std::atomic<int>		nextJob;
+		};
+	}
+}
@@ -9,10 +9,14 @@
 #include "../../Common/TextureLoader.h"
 
 #include <string>
+#include <cmath>
 
 using namespace NCL;
 using namespace CSC8503;
 
+#define TERRAIN_SAMPLES 41		//per side, so 3200 triangles
+#define TERRAIN_CELL_SIZE 2.0f
+
 TutorialGame::TutorialGame(){
 	world		= new GameWorld();
 	renderer	= new GameTechRenderer(*world);
@@ -57,6 +61,8 @@ void TutorialGame::InitialiseAssets() {
 	/**/
 	loadFunc("Cylinder.msh", &cylinderMesh);
 
+	InitTerrainMesh();
+
 	basicTex	= (OGLTexture*)TextureLoader::LoadAPITexture("checkerboard.png");
 	basicShader = new OGLShader("GameTechVert.glsl", "GameTechFrag.glsl");
 
@@ -71,6 +77,7 @@ TutorialGame::~TutorialGame()	{
 	delete charMeshB;
 	delete enemyMesh;
 	delete bonusMesh;
+	delete terrainMesh;
 
 	delete basicTex;
 	delete basicShader;
@@ -163,6 +170,18 @@ void TutorialGame::UpdateKeys() {
 		InitCamera(); //F2 will reset the camera to a specific default place
 	}
 
+	if (Window::GetKeyboard()->KeyPressed(KeyboardKeys::H)) {
+		AddConvexHullToWorld(Vector3(0, 30, 0), charMeshA, Vector3(3, 3, 3)); //H drops a convex hull in from above
+	}
+
+	if (Window::GetKeyboard()->KeyPressed(KeyboardKeys::K)) {
+		InitTerrainWorld(Vector3(100, -4, 0), false); //K adds a triangle mesh terrain off to the side of the floor
+	}
+
+	if (Window::GetKeyboard()->KeyPressed(KeyboardKeys::J)) {
+		InitTerrainWorld(Vector3(-100, -4, 0), true); //and J the same terrain as a heightfield, on the other side
+	}
+
 	if (Window::GetKeyboard()->KeyPressed(KeyboardKeys::G)) {
 		useGravity = !useGravity; //Toggle gravity!
 		physics->UseGravity(useGravity);
@@ -451,6 +470,75 @@ GameObject* NCL::CSC8503::TutorialGame::AddCylinderToWorld(const Vector3& positi
 	return cylinder;
 }
 
+GameObject* TutorialGame::AddConvexHullToWorld(const Vector3& position, OGLMesh* mesh, const Vector3& scale, float inverseMass) {
+	GameObject* hull = new GameObject("hull");
+
+	ConvexHullVolume* volume = new ConvexHullVolume(mesh->GetPositionData(), scale);
+	hull->SetBoundingVolume((CollisionVolume*)volume);
+
+	hull->GetTransform()
+		.SetScale(scale)
+		.SetPosition(position);
+
+	hull->SetRenderObject(new RenderObject(&hull->GetTransform(), mesh, basicTex, basicShader));
+	hull->SetPhysicsObject(new PhysicsObject(&hull->GetTransform(), hull->GetBoundingVolume()));
+
+	hull->GetRenderObject()->SetColour(Vector4(1, 0.75, 0.5, 1));
+
+	hull->GetPhysicsObject()->SetInverseMass(inverseMass);
+	hull->GetPhysicsObject()->InitCubeInertia(volume->GetLocalHalfSizes()); //the scale is the mesh's, not the hull's size
+
+	world->AddGameObject(hull);
+
+	return hull;
+}
+
+//Static level geometry, collided with triangle by triangle
+GameObject* TutorialGame::AddTriangleMeshToWorld(const Vector3& position, OGLMesh* mesh, const Vector3& scale) {
+	GameObject* level = new GameObject("level");
+
+	TriangleMeshVolume* volume = new TriangleMeshVolume(*mesh, scale);
+	level->SetBoundingVolume((CollisionVolume*)volume);
+
+	level->GetTransform()
+		.SetScale(scale)
+		.SetPosition(position);
+
+	level->SetRenderObject(new RenderObject(&level->GetTransform(), mesh, basicTex, basicShader));
+	level->SetPhysicsObject(new PhysicsObject(&level->GetTransform(), level->GetBoundingVolume()));
+
+	level->GetPhysicsObject()->SetInverseMass(0);
+	level->GetPhysicsObject()->InitCubeInertia();
+	level->GetPhysicsObject()->SetPhysicsType(PhysicsType::Static);
+
+	world->AddGameObject(level);
+
+	return level;
+}
+
+//The terrain mesh's heights as a heightfield, drawn with the terrain mesh
+GameObject* TutorialGame::AddHeightfieldToWorld(const Vector3& position) {
+	GameObject* level = new GameObject("heightfield");
+
+	HeightfieldVolume* volume = new HeightfieldVolume(TERRAIN_SAMPLES, TERRAIN_SAMPLES, terrainHeights, TERRAIN_CELL_SIZE);
+	level->SetBoundingVolume((CollisionVolume*)volume);
+
+	level->GetTransform()
+		.SetScale(Vector3(1, 1, 1))
+		.SetPosition(position);
+
+	level->SetRenderObject(new RenderObject(&level->GetTransform(), terrainMesh, basicTex, basicShader));
+	level->SetPhysicsObject(new PhysicsObject(&level->GetTransform(), level->GetBoundingVolume()));
+
+	level->GetPhysicsObject()->SetInverseMass(0);
+	level->GetPhysicsObject()->InitCubeInertia();
+	level->GetPhysicsObject()->SetPhysicsType(PhysicsType::Static);
+
+	world->AddGameObject(level);
+
+	return level;
+}
+
 GameObject* TutorialGame::AddCubeToWorld(const Vector3& position, Vector3 dimensions, float inverseMass, bool bStatic, float elasticity) {
 	GameObject* cube = new GameObject("cube");
 
@@ -544,6 +632,72 @@ void TutorialGame::InitCubeGridWorld(int numRows, int numCols, float rowSpacing,
 	}
 }
 
+/*
+Some rolling hills to try the triangle mesh and heightfield collisions on, built once along
+with the other meshes. The vertices are laid out the same way as HeightfieldVolume's samples,
+centred on the object, with each cell split from (x, z) to (x + 1, z + 1), so the one mesh
+draws both.
+*/
+void TutorialGame::InitTerrainMesh() {
+	float halfWidth = (TERRAIN_SAMPLES - 1) * TERRAIN_CELL_SIZE * 0.5f;
+
+	terrainHeights.clear();
+
+	vector<Vector3>			positions;
+	vector<Vector2>			texCoords;
+	vector<unsigned int>	indices;
+
+	for (int z = 0; z < TERRAIN_SAMPLES; ++z) {
+		for (int x = 0; x < TERRAIN_SAMPLES; ++x) {
+			float height = 3.0f * sin(x * 0.35f) * cos(z * 0.25f);
+			terrainHeights.push_back(height);
+			positions.push_back(Vector3(x * TERRAIN_CELL_SIZE - halfWidth, height, z * TERRAIN_CELL_SIZE - halfWidth));
+			texCoords.push_back(Vector2((float)x, (float)z) * 0.5f);
+		}
+	}
+	for (int z = 0; z < TERRAIN_SAMPLES - 1; ++z) {
+		for (int x = 0; x < TERRAIN_SAMPLES - 1; ++x) {
+			unsigned int a = z * TERRAIN_SAMPLES + x;
+			unsigned int b = a + TERRAIN_SAMPLES;	//(x, z + 1)
+			unsigned int c = b + 1;					//(x + 1, z + 1)
+			unsigned int d = a + 1;					//(x + 1, z)
+
+			indices.push_back(a); indices.push_back(b); indices.push_back(c);
+			indices.push_back(a); indices.push_back(c); indices.push_back(d);
+		}
+	}
+
+	terrainMesh = new OGLMesh();
+	terrainMesh->SetVertexPositions(positions);
+	terrainMesh->SetVertexTextureCoords(texCoords);
+	terrainMesh->SetVertexIndices(indices);
+	terrainMesh->RecalculateNormals();
+	terrainMesh->SetPrimitiveType(GeometryPrimitive::Triangles);
+	terrainMesh->UploadToGPU();
+}
+
+//The terrain with a grid of spheres and cubes above it to drop onto it
+void TutorialGame::InitTerrainWorld(const Vector3& centre, bool useHeightfield) {
+	if (useHeightfield) {
+		AddHeightfieldToWorld(centre);
+	}
+	else {
+		AddTriangleMeshToWorld(centre, terrainMesh, Vector3(1, 1, 1));
+	}
+
+	for (int x = 0; x < 4; ++x) {
+		for (int z = 0; z < 4; ++z) {
+			Vector3 position = centre + Vector3(x * 10.0f - 15.0f, 15.0f, z * 10.0f - 15.0f);
+			if ((x + z) % 2) {
+				AddCubeToWorld(position, Vector3(2, 2, 2));
+			}
+			else {
+				AddSphereToWorld(position, 2.0f);
+			}
+		}
+	}
+}
+
 void TutorialGame::InitDefaultFloor() {
 	AddFloorToWorld(Vector3(0, -4, 0));
 }
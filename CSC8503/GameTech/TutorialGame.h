@@ -23,6 +23,7 @@ namespace NCL {
 
 
 			void InitialiseAssets();
+			void InitTerrainMesh();
 
 			void InitCamera();
 
@@ -32,6 +33,7 @@ namespace NCL {
 			void InitSphereGridWorld(int numRows, int numCols, float rowSpacing, float colSpacing, float radius);
 			void InitMixedGridWorld(int numRows, int numCols, float rowSpacing, float colSpacing, float height);
 			void InitCubeGridWorld(int numRows, int numCols, float rowSpacing, float colSpacing, const Vector3& cubeDims);
+			void InitTerrainWorld(const Vector3& centre, bool useHeightfield);
 			void InitDefaultFloor();
 
 
@@ -47,6 +49,9 @@ namespace NCL {
 			/**/
 			GameObject* AddCapsuleToWorld(const Vector3& position, float halfHeight, float radius, float inverseMass = 5.0f);
 			GameObject* AddCylinderToWorld(const Vector3& position, float halfHeight, float radius, float inverseMass = 5.0f);
+			GameObject* AddConvexHullToWorld(const Vector3& position, OGLMesh* mesh, const Vector3& scale, float inverseMass = 5.0f);
+			GameObject* AddTriangleMeshToWorld(const Vector3& position, OGLMesh* mesh, const Vector3& scale);
+			GameObject* AddHeightfieldToWorld(const Vector3& position);
 
 
 			GameTechRenderer*	renderer;
@@ -75,6 +80,8 @@ namespace NCL {
 
 			/**/
 			OGLMesh* cylinderMesh = nullptr;
+			OGLMesh* terrainMesh = nullptr;
+			std::vector<float> terrainHeights;
 
 			//Coursework Additional functionality	
 			GameObject* lockedObject	= nullptr;